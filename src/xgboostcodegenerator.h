@@ -0,0 +1,341 @@
+#pragma once
+
+#include "xgboostpredictor.h"
+
+#include <cstdio>
+#include <ostream>
+#include <string>
+
+namespace xgboost::predictor
+{
+
+//------------------------------------------------------------------------------
+
+// generator of C++ header with XGBoost model compiled to code
+// each tree becomes nested if/else with constant thresholds, generated class
+// has the same predict signatures and transformation as XGBoostPredictor, models
+// with remapped features get their feature table and remap
+class XGBoostCodeGenerator
+{
+public:
+    //------------------------------------------------------------------------------
+    // generate header with class className (in namespace nameSpace, if not empty)
+    //------------------------------------------------------------------------------
+    static void generate(const XGBoostPredictor& predictor, const std::string& className, const std::string& nameSpace, std::ostream& out)
+    {
+        const auto& model = predictor.model();
+
+        out << "#pragma once\n\n";
+        out << "// generated by XGBoostCodeGenerator, do not edit\n\n";
+        out << "#include \"xgboostpredictor.h\"\n\n";
+
+        if (!nameSpace.empty())
+        {
+            out << "namespace " << nameSpace << "\n{\n\n";
+        }
+
+        out << "//------------------------------------------------------------------------------\n\n";
+        out << "// compiled XGBoost model\n";
+        out << "class " << className << "\n";
+        out << "{\n";
+        out << "public:\n";
+        out << "    using XGBoostPredictor = xgboost::predictor::XGBoostPredictor;\n";
+        out << "    using Data = XGBoostPredictor::Data;\n";
+        out << "    using Transformation = XGBoostPredictor::Transformation;\n\n";
+        out << "    static constexpr Transformation transformation = Transformation::" << transformation(model.transformation) << ";\n\n";
+
+        out << R"(    //------------------------------------------------------------------------------
+    // make prediction
+    //------------------------------------------------------------------------------
+    std::vector<float> predict(const Data& data, const bool outputMargin = false) const
+    {
+        return predictAll(DataDecision{data}, outputMargin);
+    }
+
+    //------------------------------------------------------------------------------
+    // make prediction from dense data, NaN value is missing feature
+    //------------------------------------------------------------------------------
+    std::vector<float> predict(const float* data, const size_t size, const bool outputMargin = false) const
+    {
+        return predictAll(DenseDecision{data, size}, outputMargin);
+    }
+
+    //------------------------------------------------------------------------------
+    // make multiple predictions
+    //------------------------------------------------------------------------------
+    std::vector<float> predict(const std::vector<Data>& data, const bool outputMargin = false) const
+    {
+)";
+        if (model.predictors.size() != 1)
+        {
+            out << "        throw std::runtime_error(\"xgboost predict incompatible model size: " << model.predictors.size() << "\");\n";
+        }
+        else
+        {
+            out << R"(        std::vector<float> scores;
+        scores.reserve(data.size());
+
+        for (const auto& d : data)
+        {
+            scores.push_back(predict0(DataDecision{d}));
+        }
+
+        if (!outputMargin)
+        {
+            XGBoostPredictor::transform(scores, transformation);
+        }
+
+        return scores;
+)";
+        }
+        out << R"(    }
+
+    //------------------------------------------------------------------------------
+    // number of features used by the model (max feature index + 1)
+    // model features of remapped features (see remap)
+    //------------------------------------------------------------------------------
+    static constexpr size_t numFeatures()
+    {
+        return )" << model.num_features << R"(;
+    }
+)";
+        generateRemap(model, out);
+        out << R"(
+
+private:
+    // decision on data: if (feature < threshold) yes, missing feature follows default direction
+    struct DataDecision
+    {
+        const Data& data;
+
+        bool operator()(const uint32_t feature, const float threshold, const bool defaultLeft) const
+        {
+            return feature < data.size() && data[feature] ? *data[feature] < threshold : defaultLeft;
+        }
+    };
+
+    // decision on dense data: NaN value is missing feature
+    struct DenseDecision
+    {
+        const float* data;
+        const size_t size;
+
+        bool operator()(const uint32_t feature, const float threshold, const bool defaultLeft) const
+        {
+            const float value = feature < size ? data[feature] : std::numeric_limits<float>::quiet_NaN();
+            return (value < threshold) | (std::isnan(value) & defaultLeft);
+        }
+    };
+
+    //------------------------------------------------------------------------------
+    // calculate predictions of all predictors
+    //------------------------------------------------------------------------------
+    template<typename Decision>
+    static std::vector<float> predictAll(const Decision& yes, const bool outputMargin)
+    {
+        std::vector<float> predictions{)";
+
+        for (size_t i = 0; i < model.predictors.size(); ++i)
+        {
+            out << (i ? ", " : "") << "predict" << i << "(yes)";
+        }
+
+        out << R"(};
+
+        if (!outputMargin)
+        {
+            XGBoostPredictor::transform(predictions, transformation);
+        }
+
+        return predictions;
+    }
+)";
+
+        // predictors
+        for (size_t i = 0; i < model.predictors.size(); ++i)
+        {
+            const auto& p = model.predictors[i];
+
+            out << "\n";
+            out << "    //------------------------------------------------------------------------------\n";
+            out << "    // calculate prediction of predictor " << i << "\n";
+            out << "    //------------------------------------------------------------------------------\n";
+            out << "    template<typename Decision>\n";
+            out << "    static float predict" << i << "(const Decision& yes)\n";
+            out << "    {\n";
+            out << "        float prediction = 0.0f;\n\n";
+
+            for (uint32_t tree = p.begin; tree < p.end; ++tree)
+            {
+                out << "        prediction += tree" << tree << "(yes);\n";
+            }
+
+            out << "\n";
+            out << "        prediction += " << literal(model.base_score) << ";\n\n";
+            out << "        return prediction;\n";
+            out << "    }\n";
+        }
+
+        // trees
+        for (size_t tree = 0; tree < model.trees.size(); ++tree)
+        {
+            out << "\n";
+            out << "    //------------------------------------------------------------------------------\n";
+            out << "    // calculate tree " << tree << " prediction\n";
+            out << "    //------------------------------------------------------------------------------\n";
+            out << "    template<typename Decision>\n";
+            out << "    static float tree" << tree << "(const Decision& yes)\n";
+            out << "    {\n";
+            generate(model, model.trees[tree].root, 2, out);
+            out << "    }\n";
+        }
+
+        out << "};\n\n";
+        out << "//------------------------------------------------------------------------------\n";
+
+        if (!nameSpace.empty())
+        {
+            out << "\n} // namespaces\n";
+        }
+    }
+
+
+private:
+    //------------------------------------------------------------------------------
+    // generate remap functions like XGBoostPredictor::remap, with the table of model
+    // features of models with remapped features (Options::remap_features)
+    //------------------------------------------------------------------------------
+    static void generateRemap(const XGBoostPredictor::Model& model, std::ostream& out)
+    {
+        if (!model.features.empty())
+        {
+            out << "\n";
+            out << "    // original features of model features\n";
+            out << "    static constexpr uint32_t features[" << model.features.size() << "] = {";
+            for (size_t i = 0; i < model.features.size(); ++i)
+            {
+                out << (i ? ", " : "") << model.features[i];
+            }
+            out << "};\n";
+        }
+
+        out << R"(
+    //------------------------------------------------------------------------------
+    // row of model features from row of original features, data is returned as is
+    // if features are not remapped
+    //------------------------------------------------------------------------------
+    static Data remap(const Data& data)
+    {
+)";
+        if (model.features.empty())
+        {
+            out << "        return data;\n";
+        }
+        else
+        {
+            out << R"(        Data result(numFeatures());
+        for (size_t i = 0; i < result.size(); ++i)
+        {
+            if (features[i] < data.size())
+            {
+                result[i] = data[features[i]];
+            }
+        }
+        return result;
+)";
+        }
+
+        out << R"(    }
+
+    //------------------------------------------------------------------------------
+    // dense row of model features from dense row of original features into
+    // result[0, numFeatures()), size is capacity of result, NaN value is missing feature
+    //------------------------------------------------------------------------------
+    static void remap(const float* data, const size_t size, float* result, const size_t resultSize)
+    {
+        if (resultSize < numFeatures())
+        {
+            throw std::runtime_error("xgboost predict output too small: " + std::to_string(resultSize) + " < " + std::to_string(numFeatures()));
+        }
+
+        for (size_t i = 0; i < numFeatures(); ++i)
+        {
+)";
+        out << "            const size_t feature = " << (model.features.empty() ? "i" : "features[i]") << ";\n";
+        out << R"(            result[i] = feature < size ? data[feature] : std::numeric_limits<float>::quiet_NaN();
+        }
+    }
+)";
+    }
+
+    //------------------------------------------------------------------------------
+    // generate decision node
+    //------------------------------------------------------------------------------
+    static void generate(const XGBoostPredictor::Model& model, const uint32_t index, const size_t depth, std::ostream& out)
+    {
+        const auto& node = model.nodes[index];
+        const std::string indent(depth * 4, ' ');
+
+        out << indent << "if (yes(" << node.feature() << ", " << literal(node.value) << ", " << (node.defaultLeft() ? "true" : "false") << "))\n";
+
+        for (unsigned int child = 0; child < 2; ++child)
+        {
+            if (child == 1)
+            {
+                out << indent << "else\n";
+            }
+
+            out << indent << "{\n";
+            if (node.isLeaf(child))
+            {
+                out << indent << "    return " << literal(node.children[child].value) << ";\n";
+            }
+            else
+            {
+                generate(model, node.children[child].offset, depth + 1, out);
+            }
+            out << indent << "}\n";
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // exact float literal
+    //------------------------------------------------------------------------------
+    static std::string literal(const float value)
+    {
+        if (std::isnan(value))
+        {
+            return "std::numeric_limits<float>::quiet_NaN()";
+        }
+
+        if (std::isinf(value))
+        {
+            return value > 0 ? "std::numeric_limits<float>::infinity()" : "-std::numeric_limits<float>::infinity()";
+        }
+
+        // hexadecimal float literal represents value exactly
+        char buffer[64];
+        std::snprintf(buffer, sizeof(buffer), "%af", value);
+        return buffer;
+    }
+
+    //------------------------------------------------------------------------------
+    // transformation name
+    //------------------------------------------------------------------------------
+    static const char* transformation(const XGBoostPredictor::Transformation transformation)
+    {
+        switch (transformation)
+        {
+            case XGBoostPredictor::Transformation::SIGMOID:
+                return "SIGMOID";
+            case XGBoostPredictor::Transformation::SOFTMAX:
+                return "SOFTMAX";
+            default:
+                return "NONE";
+        }
+    }
+};
+
+//------------------------------------------------------------------------------
+
+} // namespaces
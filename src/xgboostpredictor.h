@@ -1,20 +1,54 @@
 #pragma once
 
-#include <rapidjson/document.h>
+#include <rapidjson/reader.h>
 #include <rapidjson/error/en.h>
 #include <rapidjson/istreamwrapper.h>
 
+#include "xgboostthreadpool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
 #include <string>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 #include <fstream>
 
+#if __cplusplus >= 202002L
+#include <span>
+#endif
+
 #ifdef USE_EXPERIMENTAL_OPTIONAL
 #include <experimental/optional>
 #else
 #include <optional>
 #endif
 
+// binary model files are memory mapped
+#if defined(__unix__) || defined(__APPLE__)
+#define XGBOOST_PREDICTOR_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// AVX2/AVX-512 batch kernels, selected at runtime according to CPU features
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__)) && !defined(XGBOOST_PREDICTOR_NO_SIMD)
+#define XGBOOST_PREDICTOR_SIMD
+#include <immintrin.h>
+#endif
+
 namespace xgboost::predictor
 {
 
@@ -39,407 +73,5198 @@ public:
     using Data = std::vector<std::optional<float>>;
 #endif
 
+    // dense rows, features of row i are values[i * columns, (i + 1) * columns), NaN value is missing feature
+    struct DenseData
+    {
+        const float* values = nullptr;
+        size_t rows = 0;
+        size_t columns = 0;
+    };
+
+    // sparse rows in CSR format, features of row i are indices/values[offsets[i], offsets[i + 1])
+    // feature not present or with NaN value is missing
+    struct CSRData
+    {
+        const size_t* offsets = nullptr;    // rows + 1 row offsets
+        const uint32_t* indices = nullptr;  // feature indices
+        const float* values = nullptr;      // feature values
+        size_t rows = 0;
+    };
+
+    // prediction engines
+    enum class Engine
+    {
+        TREE,           // tree traversal
+        QUICKSCORER,    // QuickScorer leaf bitvectors, for ensembles of shallow trees
+        QUANTIZED       // traversal of 8-byte nodes comparing uint8/uint16 feature bins, rows binned once per predictor
+    };
+
+    // node arena layout of JSON/UBJSON models, decision nodes of a tree are in preorder
+    enum class Layout
+    {
+        PREORDER,       // yes child follows its parent
+        COVER           // child with larger sum_hessian (training samples) follows its parent
+    };
+
+    // predictor options
+    struct Options
+    {
+        Engine engine = Engine::TREE;
+        size_t row_block = 64;                  // rows passing through a block of trees in batch prediction
+        size_t tree_block_bytes = 32 * 1024;    // node bytes of a block of trees in batch prediction (~L1d), 0 = all trees
+        bool simd = true;                       // use AVX2/AVX-512 kernels for dense batch prediction if CPU supports them
+        bool fast_transform = false;            // vectorized output transformation of predictions (see transformMargins)
+        std::shared_ptr<Executor> executor;     // executor of parallel batch prediction (e.g. ThreadPool), nullptr = calling thread
+        size_t parallel_rows = 1024;            // min rows of batch predicted in parallel
+        size_t parallel_trees = 0;              // min trees of predictor for tree-parallel single row prediction on executor, 0 = off
+        size_t tree_chunks = 4;                 // tree chunks of tree-parallel prediction, partial sums are added in chunk order
+        Layout layout = Layout::PREORDER;       // node arena layout of JSON/UBJSON models (binary models keep their layout)
+        bool count_hits = false;                // record branch counts of nodes (hitCounts), rows are predicted one by one by tree traversal
+        bool compact = false;                   // compact model at load time (see compactionStats)
+        bool remap_features = false;            // compact and renumber used features densely, rows are in model features (see remap)
+        bool profile = false;                   // record latency histogram of predict calls (see profile), predictions run the configured engine
+        size_t profile_sample = 0;              // trace every n-th row by tree traversal recording nodes, missing values and time per tree (see profile), 0 = off
+    };
+
+    // tree-parallel single row prediction statistics
+    // overhead (scheduling, reduction) = wall_ns - critical_ns, speedup = work_ns / wall_ns
+    struct TreeParallelStats
+    {
+        uint64_t calls = 0;         // tree-parallel predictor evaluations
+        uint64_t wall_ns = 0;       // total time of evaluations
+        uint64_t work_ns = 0;       // total time of all chunks (sequential work estimate)
+        uint64_t critical_ns = 0;   // total time of the slowest chunk of each evaluation
+    };
+
+    // bounded prediction: trees are summed in order until the remaining trees cannot
+    // change whether the margin reaches the cutoff
+    struct BoundedPrediction
+    {
+        bool above = false;         // margin >= cutoff
+        double lower = 0.0;         // bounds of margin, both equal to margin when all trees are evaluated
+        double upper = 0.0;
+        uint32_t trees = 0;         // trees evaluated, the following trees of the predictor were skipped
+    };
+
+    // hot path profile (Options::profile, Options::profile_sample), counters of all threads merged
+    // nodes per row of tree i = tree_nodes[i] / rows of its predictor,
+    // missing value rate of feature f = feature_missing[f] / feature_splits[f]
+    struct Profile
+    {
+        std::vector<uint64_t> latency;          // predict calls (single row or batch) per latency bucket, bucket i: [2^i, 2^(i + 1)) ns
+        std::vector<uint64_t> rows;             // rows traced per predictor
+        std::vector<uint64_t> tree_nodes;       // decision nodes visited per tree
+        std::vector<uint64_t> tree_ns;          // evaluation time per tree
+        std::vector<uint64_t> feature_splits;   // decisions per feature
+        std::vector<uint64_t> feature_missing;  // decisions per feature with missing value (default direction)
+    };
+
+    // model compaction statistics (Options::compact)
+    // bytes are node arena, tree, predictor and feature tables
+    struct CompactionStats
+    {
+        size_t nodes_before = 0;
+        size_t nodes_after = 0;
+        size_t trees_before = 0;
+        size_t trees_after = 0;
+        size_t bytes_before = 0;
+        size_t bytes_after = 0;
+        size_t features_before = 0;     // numFeatures
+        size_t features_after = 0;
+        size_t redundant_splits = 0;    // decision nodes with identical children replaced by the child
+        size_t zero_trees = 0;          // trees of zero leaves only, dropped
+        size_t shared_subtrees = 0;     // subtrees shared with an identical subtree of an earlier tree
+    };
+
+    // binary model file format version (2: feature table)
+    static constexpr uint32_t BINARY_VERSION = 2;
+
     //------------------------------------------------------------------------------
-    // create predictor from JSON model file
+    // create predictor from JSON or binary model file
     //------------------------------------------------------------------------------
-    XGBoostPredictor(const std::string& jsonFile)
-        :m_model(parse(jsonFile))
+    XGBoostPredictor(const std::string& modelFile)
+        :XGBoostPredictor(modelFile, Options())
     {}
 
     //------------------------------------------------------------------------------
-    // make prediction
+    // create predictor from JSON or binary model file with options
+    // binary model file (see save) is memory mapped, its node arena is used in place
     //------------------------------------------------------------------------------
-    std::vector<float> predict(const Data& data, const bool outputMargin = false) const
-    {
-        std::vector<float> predictions;
-        predictions.reserve(m_model.predictors.size());
+    XGBoostPredictor(const std::string& modelFile, const Options& options)
+        :XGBoostPredictor(load(modelFile, options), options)
+    {}
+
+    //------------------------------------------------------------------------------
+    // create predictor of model of predictor relaid out by hit counts (see hitCounts):
+    // the more often taken child of each decision node follows it in the node arena,
+    // so the likely path through a tree is mostly sequential in memory
+    // predictions are identical, save() keeps the layout
+    //------------------------------------------------------------------------------
+    XGBoostPredictor(const XGBoostPredictor& predictor, const std::vector<uint64_t>& hitCounts, const Options& options)
+        :XGBoostPredictor(relayout(predictor.m_model, hitCounts), options)
+    {}
 
-        for (const auto& predictor : m_model.predictors)
+    //------------------------------------------------------------------------------
+    // save compiled model to versioned, checksummed binary model file
+    // the file is in native byte order and loads only on hosts of the same byte order
+    //------------------------------------------------------------------------------
+    void save(const std::string& binaryFile) const
+    {
+        auto align = [](const uint64_t offset)
         {
-            predictions.push_back(predict(data, predictor));
-        }
+            return (offset + BINARY_ALIGNMENT - 1) / BINARY_ALIGNMENT * BINARY_ALIGNMENT;
+        };
 
-        if (!outputMargin)
+        BinaryHeader header;
+        header.nodes_offset = align(sizeof(BinaryHeader));
+        header.nodes = m_model.nodes.size();
+        header.trees_offset = align(header.nodes_offset + header.nodes * sizeof(Node));
+        header.trees = m_model.trees.size();
+        header.predictors_offset = align(header.trees_offset + header.trees * sizeof(Tree));
+        header.predictors = m_model.predictors.size();
+        header.features_offset = align(header.predictors_offset + header.predictors * sizeof(Predictor));
+        header.features = m_model.features.size();
+        header.file_size = align(header.features_offset + header.features * sizeof(uint32_t));
+        header.num_features = m_model.num_features;
+        header.base_score = m_model.base_score;
+        header.transformation = static_cast<uint32_t>(m_model.transformation);
+
+        std::vector<char> buffer(header.file_size);
+        std::memcpy(buffer.data() + header.nodes_offset, m_model.nodes.data(), header.nodes * sizeof(Node));
+        std::memcpy(buffer.data() + header.trees_offset, m_model.trees.data(), header.trees * sizeof(Tree));
+        std::memcpy(buffer.data() + header.predictors_offset, m_model.predictors.data(), header.predictors * sizeof(Predictor));
+        std::memcpy(buffer.data() + header.features_offset, m_model.features.data(), header.features * sizeof(uint32_t));
+
+        std::memcpy(buffer.data(), &header, sizeof(header));
+        header.checksum = checksum(buffer.data(), buffer.size());
+        std::memcpy(buffer.data(), &header, sizeof(header));
+
+        std::ofstream stream(binaryFile, std::ios::binary | std::ios::trunc);
+        stream.write(buffer.data(), buffer.size());
+        stream.close();
+        if (!stream)
         {
-            transform(predictions, m_model.transformation);
+            throw std::runtime_error("can't write binary model file: " + binaryFile);
         }
+    }
 
+    //------------------------------------------------------------------------------
+    // make prediction
+    //------------------------------------------------------------------------------
+    std::vector<float> predict(const Data& data, const bool outputMargin = false) const
+    {
+        std::vector<float> predictions(m_model.predictors.size());
+        predict(data, predictions.data(), predictions.size(), outputMargin);
         return predictions;
     }
 
     //------------------------------------------------------------------------------
-    // make multiple predictions
+    // make prediction into predictions[0, numPredictors()), size is capacity of predictions
+    // output overloads do not allocate (per-thread scratch buffers are reused), so
+    // steady state prediction does not touch the heap
     //------------------------------------------------------------------------------
-    std::vector<float> predict(const std::vector<Data>& data, const bool outputMargin = false) const
+    void predict(const Data& data, float* predictions, const size_t size, const bool outputMargin = false) const
     {
-        if (m_model.predictors.size() != 1)
-        {
-            throw std::runtime_error("xgboost predict incompatible model size: " + std::to_string(m_model.predictors.size()));
-        }
+        checkOutput(size, m_model.predictors.size());
 
-        std::vector<float> scores;
-        scores.reserve(data.size());
+        profileRows(1, [&data](const size_t, const uint32_t feature, float& value)
+        {
+            return featureValue(data, feature, value);
+        });
+        const ProfileLatency latency(latencyCounters());
 
-        for (const auto& d: data)
+        for (size_t i = 0; i < m_model.predictors.size(); ++i)
         {
-            scores.push_back(predict(d, m_model.predictors.front()));
+            predictions[i] = predict(data, m_model.predictors[i]);
         }
 
         if (!outputMargin)
         {
-            transform(scores, m_model.transformation);
+            transformMargins(predictions, m_model.predictors.size(), m_model.predictors.size());
         }
+    }
 
-        return scores;
+    //------------------------------------------------------------------------------
+    // make prediction from dense data, NaN value is missing feature
+    // data of at least numFeatures() values take the fast path without bounds checks
+    //------------------------------------------------------------------------------
+    std::vector<float> predict(const float* data, const size_t size, const bool outputMargin = false) const
+    {
+        std::vector<float> predictions(m_model.predictors.size());
+        predict(data, size, predictions.data(), predictions.size(), outputMargin);
+        return predictions;
     }
 
     //------------------------------------------------------------------------------
-    // output margin transformation according to the objective
+    // make prediction from dense data into predictions[0, numPredictors())
     //------------------------------------------------------------------------------
-    static void transform(std::vector<float>& predictions, const Transformation transformation)
+    void predict(const float* data, const size_t size, float* predictions, const size_t predictionsSize, const bool outputMargin = false) const
     {
-        if (predictions.empty())
+        checkOutput(predictionsSize, m_model.predictors.size());
+
+        profileRows(1, [data, size](const size_t, const uint32_t feature, float& value)
         {
-            return;
-        }
+            return featureValue(data, size, feature, value);
+        });
+        const ProfileLatency latency(latencyCounters());
 
-        if (transformation == Transformation::SIGMOID)
+        for (size_t i = 0; i < m_model.predictors.size(); ++i)
         {
-            transformSigmoid(predictions);
+            const auto& predictor = m_model.predictors[i];
+            predictions[i] = size >= m_model.num_features ? predict<false>(data, size, predictor) : predict<true>(data, size, predictor);
         }
-        else if (transformation == Transformation::SOFTMAX)
+
+        if (!outputMargin)
         {
-            transformSoftmax(predictions);
+            transformMargins(predictions, m_model.predictors.size(), m_model.predictors.size());
         }
     }
 
+#ifdef __cpp_lib_span
     //------------------------------------------------------------------------------
-    // sigmoid transformation
+    // make prediction from dense data, NaN value is missing feature
     //------------------------------------------------------------------------------
-    static void transformSigmoid(std::vector<float>& predictions)
+    std::vector<float> predict(const std::span<const float> data, const bool outputMargin = false) const
     {
-        for (float& prediction: predictions)
-        {
-            prediction = 1.0f / (1.0f + expf(-prediction));
-        }
+        return predict(data.data(), data.size(), outputMargin);
     }
 
     //------------------------------------------------------------------------------
-    // softmax transformation
+    // make prediction from dense data into span of at least numPredictors() values
     //------------------------------------------------------------------------------
-    static void transformSoftmax(std::vector<float>& predictions)
+    void predict(const std::span<const float> data, const std::span<float> predictions, const bool outputMargin = false) const
     {
-        // softmax transformation
-        float max = std::numeric_limits<float>::min();
-        for (const float prediction : predictions)
-        {
-            max = std::max(max, prediction);
-        }
-        double sum = 0.0;
-        for (float& prediction : predictions)
-        {
-            prediction = expf(prediction - max);
-            sum += prediction;
-        }
-        for (float& prediction : predictions)
-        {
-            prediction /= sum;
-        }
+        predict(data.data(), data.size(), predictions.data(), predictions.size(), outputMargin);
     }
 
-
-private:
-    // decision node of tree
-    struct Node
+    //------------------------------------------------------------------------------
+    // make prediction(s) of Data, std::vector<Data>, DenseData or CSRData into span
+    //------------------------------------------------------------------------------
+    template<typename Input>
+    void predict(const Input& data, const std::span<float> predictions, const bool outputMargin = false) const
     {
-        float value = 0.0f;         // threshold value for decision node, leaf value for leaf node
-        int feature = -1;           // feature index for decision node, -1 for leaf node
-        unsigned int yes = 0;       // if (feature < value) next node index = yes
-        unsigned int no = 0;        // if (feature >= value) next node index = no
-        unsigned int missing = 0;   // if (feature is missing) next node index = missing
-    };
-
-    // tree
-    using Tree = std::vector<Node>;
-
-    // predictor
-    using Predictor = std::vector<Tree>;
+        predict(data, predictions.data(), predictions.size(), outputMargin);
+    }
 
-    // model: multiple predictors for multiclass prediction
-    //        transformed base score (according to the objective)
-    struct Model
+    //------------------------------------------------------------------------------
+    // make predictions of all predictors of std::vector<Data> or DenseData into span
+    //------------------------------------------------------------------------------
+    template<typename Input>
+    void predictMatrix(const Input& data, const std::span<float> predictions, const bool outputMargin = false) const
     {
-        const std::vector<Predictor> predictors;
-        const float base_score = 0.0f;
-        const Transformation transformation = Transformation::NONE;
-    };
-
+        predictMatrix(data, predictions.data(), predictions.size(), outputMargin);
+    }
+#endif
 
-private:
     //------------------------------------------------------------------------------
-    // calculate prediction
+    // make multiple predictions
     //------------------------------------------------------------------------------
-    float predict(const Data& data, const Predictor& predictor) const
+    std::vector<float> predict(const std::vector<Data>& data, const bool outputMargin = false) const
     {
-        float prediction = 0.0f;
-
-        for (const auto& tree : predictor)
-        {
-            prediction += predict(data, tree);
-        }
-
-        prediction += m_model.base_score;
-
-        return prediction;
+        std::vector<float> scores(data.size());
+        predict(data, scores.data(), scores.size(), outputMargin);
+        return scores;
     }
 
     //------------------------------------------------------------------------------
-    // calculate tree prediction
+    // make multiple predictions into scores[0, rows)
     //------------------------------------------------------------------------------
-    float predict(const Data& data, const Tree& tree) const
+    void predict(const std::vector<Data>& data, float* scores, const size_t size, const bool outputMargin = false) const
     {
-        const auto size = data.size();
+        if (m_model.predictors.size() != 1)
+        {
+            throw std::runtime_error("xgboost predict incompatible model size: " + std::to_string(m_model.predictors.size()));
+        }
 
-        unsigned int index = 0;
+        checkOutput(size, data.size());
 
-        while (true)
+        profileRows(data.size(), [&data](const size_t row, const uint32_t feature, float& value)
         {
-            const Node& node = tree[index];
+            return featureValue(data[row], feature, value);
+        });
+        const ProfileLatency latency(latencyCounters());
 
-            if (node.feature < 0)
-            {
-                return node.value;
-            }
+        const auto& predictor = m_model.predictors.front();
 
-            if (static_cast<unsigned int>(node.feature) < size && data[node.feature])
+        forEachBlock(data.size(), [this, &data, &predictor, scores](const size_t begin, const size_t end)
+        {
+            predictBatch(predictor, begin, end, scores, [this, &data](const size_t begin, const size_t end, const Tree* treeBegin, const Tree* treeEnd, float* scores)
             {
-                index = *data[node.feature] < node.value ? node.yes : node.no;
-            }
-            else
+                predictTile(begin, end, treeBegin, treeEnd, scores, [this, &data](const size_t row, const Tree& tree)
+                {
+                    return predict(data[row], tree);
+                });
+            },
+            [this, &data, &predictor](const size_t row)
             {
-                index = node.missing;
-            }
+                return predict(data[row], predictor);
+            });
+        });
+
+        if (!outputMargin)
+        {
+            transformMargins(scores, data.size(), data.size());
         }
     }
 
     //------------------------------------------------------------------------------
-    // parse JSON model file
+    // make multiple predictions from dense rows
     //------------------------------------------------------------------------------
-    static Model parse(const std::string& jsonFile)
+    std::vector<float> predict(const DenseData& data, const bool outputMargin = false) const
     {
-        // stream wrapper
-        std::ifstream stream(jsonFile);
-        rapidjson::IStreamWrapper wrapper(stream);
+        std::vector<float> scores(data.rows);
+        predict(data, scores.data(), scores.size(), outputMargin);
+        return scores;
+    }
 
-        // parse JSON model
-        rapidjson::Document doc;
-        if (doc.ParseStream(wrapper).HasParseError() || !doc.IsObject())
+    //------------------------------------------------------------------------------
+    // make multiple predictions from dense rows into scores[0, rows)
+    //------------------------------------------------------------------------------
+    void predict(const DenseData& data, float* scores, const size_t size, const bool outputMargin = false) const
+    {
+        if (m_model.predictors.size() != 1)
         {
-            throw std::runtime_error("invalid xgboost json model");
+            throw std::runtime_error("xgboost predict incompatible model size: " + std::to_string(m_model.predictors.size()));
         }
 
-        // get json object
-        auto getObject = [](const auto& value, const char* key)
-        {
-            if (!value.HasMember(key) || !value[key].IsObject())
-            {
-                throw std::runtime_error("missing or invalid json value member: " + std::string(key));
-            }
-            return value[key].GetObject();
-        };
+        checkOutput(size, data.rows);
 
-        // get json array
-        auto getArray = [](const auto& value, const char* key)
+        profileRows(data.rows, [&data](const size_t row, const uint32_t feature, float& value)
         {
-            if (!value.HasMember(key) || !value[key].IsArray())
-            {
-                throw std::runtime_error("missing or invalid json array member: " + std::string(key));
-            }
-            return value[key].GetArray();
-        };
+            return featureValue(data.values + row * data.columns, data.columns, feature, value);
+        });
+        const ProfileLatency latency(latencyCounters());
 
-        // get bool array
-        auto getArrayBool = [&getArray](const auto& value, const char* key)
-        {
-            std::vector<bool> result;
+        const auto& predictor = m_model.predictors.front();
+        const bool checked = data.columns < m_model.num_features;
 
-            for (const auto& member : getArray(value, key))
+        forEachBlock(data.rows, [this, &data, &predictor, scores, checked](const size_t begin, const size_t end)
+        {
+            predictBatch(predictor, begin, end, scores, [this, &data, checked](const size_t begin, const size_t end, const Tree* treeBegin, const Tree* treeEnd, float* scores)
             {
-                if (member.IsBool())
+                if (checked)
                 {
-                    result.emplace_back(member.GetBool());
+                    predictTile<true>(begin, end, treeBegin, treeEnd, data.values, data.columns, scores);
                 }
                 else
                 {
-                    throw std::runtime_error(std::string(key) + " json array member is not bool");
+                    predictTile<false>(begin, end, treeBegin, treeEnd, data.values, data.columns, scores);
                 }
-            }
+            },
+            [this, &data, &predictor, checked](const size_t row)
+            {
+                const float* values = data.values + row * data.columns;
+                return checked ? predict<true>(values, data.columns, predictor) : predict<false>(values, data.columns, predictor);
+            });
+        });
 
-            return result;
-        };
+        if (!outputMargin)
+        {
+            transformMargins(scores, data.rows, data.rows);
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // make multiple predictions from sparse CSR rows
+    //------------------------------------------------------------------------------
+    std::vector<float> predict(const CSRData& data, const bool outputMargin = false) const
+    {
+        std::vector<float> scores(data.rows);
+        predict(data, scores.data(), scores.size(), outputMargin);
+        return scores;
+    }
 
-        // get int array
-        auto getArrayInt = [&getArray](const auto& value, const char* key)
+    //------------------------------------------------------------------------------
+    // make multiple predictions from sparse CSR rows into scores[0, rows)
+    //------------------------------------------------------------------------------
+    void predict(const CSRData& data, float* scores, const size_t size, const bool outputMargin = false) const
+    {
+        if (m_model.predictors.size() != 1)
         {
-            std::vector<int> result;
+            throw std::runtime_error("xgboost predict incompatible model size: " + std::to_string(m_model.predictors.size()));
+        }
+
+        checkOutput(size, data.rows);
 
-            for (const auto& member : getArray(value, key))
+        for (size_t row = 0; row < data.rows; ++row)
+        {
+            if (data.offsets[row + 1] < data.offsets[row])
             {
-                if (member.IsInt())
-                {
-                    result.emplace_back(member.GetInt());
-                }
-                else
-                {
-                    throw std::runtime_error(std::string(key) + " json array member is not int");
-                }
+                throw std::runtime_error("invalid csr row offsets");
             }
+        }
 
-            return result;
-        };
-
-        // get float array
-        auto getArrayFloat = [&getArray](const auto& value, const char* key)
+        // last entry of feature wins, as in the scattered dense row
+        profileRows(data.rows, [&data](const size_t row, const uint32_t feature, float& value)
         {
-            std::vector<float> result;
-
-            for (const auto& member : getArray(value, key))
+            for (size_t i = data.offsets[row + 1]; i > data.offsets[row]; --i)
             {
-                if (member.IsDouble())
-                {
-                    result.emplace_back(member.GetDouble());
-                }
-                else if (member.IsInt64())
-                {
-                    result.emplace_back(member.GetInt64());
-                }
-                else
+                if (data.indices[i - 1] == feature)
                 {
-                    throw std::runtime_error(std::string(key) + " json array member is not double/int");
+                    value = data.values[i - 1];
+                    return !std::isnan(value);
                 }
             }
+            return false;
+        });
+        const ProfileLatency latency(latencyCounters());
 
-            return result;
-        };
+        const size_t columns = m_model.num_features;
 
-        // get json string
-        auto getString = [](const auto& value, const char* key)
+        // scatter/clear block row features used by the model
+        auto scatter = [&data, columns](const size_t begin, const size_t end, float* rows, const bool clear)
         {
-            if (!value.HasMember(key) || !value[key].IsString())
+            for (size_t row = begin; row < end; ++row, rows += columns)
             {
-                throw std::runtime_error("missing or invalid json string member: " + std::string(key));
+                for (size_t i = data.offsets[row]; i < data.offsets[row + 1]; ++i)
+                {
+                    if (data.indices[i] < columns)
+                    {
+                        rows[data.indices[i]] = clear ? std::numeric_limits<float>::quiet_NaN() : data.values[i];
+                    }
+                }
             }
-            return std::string(value[key].GetString());
         };
 
-        // get learner
-        const auto& learner = getObject(doc, "learner");
+        const auto& predictor = m_model.predictors.front();
 
-        // get gradient booster
-        const auto& gradient_booster = getObject(learner, "gradient_booster");
-
-        // get model
-        const auto& model = getObject(gradient_booster, "model");
-
-        // parse trees
-        Predictor predictor;
-
-        for (const auto& json_tree : getArray(model, "trees"))
+        forEachBlock(data.rows, [this, &scatter, &predictor, scores, columns](const size_t begin, const size_t end)
         {
-            const auto default_left = getArrayBool(json_tree, "default_left");
-            const auto left_children = getArrayInt(json_tree, "left_children");
-            const auto right_children = getArrayInt(json_tree, "right_children");
-            const auto split_indices = getArrayInt(json_tree, "split_indices");
-            const auto split_conditions = getArrayFloat(json_tree, "split_conditions");
+            // per-thread dense scratch rows of a row block, all values are NaN between blocks
+            thread_local std::vector<float> scratch;
+            if (scratch.size() < (end - begin) * columns)
+            {
+                scratch.resize((end - begin) * columns, std::numeric_limits<float>::quiet_NaN());
+            }
 
-            checkSizes(default_left.size(), left_children.size(), right_children.size(), split_indices.size(), split_conditions.size());
+            const float* rows = scratch.data();
 
-            predictor.emplace_back();
-            auto& tree = predictor.back();
+            scatter(begin, end, scratch.data(), false);
 
-            for (size_t i = 0; i < default_left.size(); ++i)
+            predictBatch(predictor, begin, end, scores, [this, rows, begin, columns](const size_t rowBegin, const size_t rowEnd, const Tree* treeBegin, const Tree* treeEnd, float* scores)
             {
-                tree.emplace_back();
-                auto& node = tree.back();
-                node.value = split_conditions[i];
-                node.feature = left_children[i] >= 0 ? split_indices[i] : -1;
-                node.yes = left_children[i];
-                node.no = right_children[i];
-                node.missing = default_left[i] ? left_children[i] : right_children[i];
-            }
+                predictTile<false>(rowBegin - begin, rowEnd - begin, treeBegin, treeEnd, rows, columns, scores + begin);
+            },
+            [this, rows, begin, columns, &predictor](const size_t row)
+            {
+                return predict<false>(rows + (row - begin) * columns, columns, predictor);
+            });
 
-            check(tree);
-        }
+            scatter(begin, end, scratch.data(), true);
+        });
 
-        // get tree_info for multiclass predictors
-        const auto tree_info = getArrayInt(model, "tree_info");
-        if (tree_info.size() != predictor.size())
+        if (!outputMargin)
         {
-            throw std::runtime_error("unexprected tree_info size: " + std::to_string(tree_info.size()) +
-                    ", trees: " + std::to_string(predictor.size()));
+            transformMargins(scores, data.rows, data.rows);
         }
+    }
 
-        // build predictors
-        std::vector<Predictor> predictors;
+    //------------------------------------------------------------------------------
+    // make multiple predictions of all predictors (classes)
+    // result is row-major matrix of rows x numPredictors() predictions
+    //------------------------------------------------------------------------------
+    std::vector<float> predictMatrix(const std::vector<Data>& data, const bool outputMargin = false) const
+    {
+        std::vector<float> scores(data.size() * m_model.predictors.size());
+        predictMatrix(data, scores.data(), scores.size(), outputMargin);
+        return scores;
+    }
 
-        for (size_t i = 0; i < tree_info.size(); ++i)
+    //------------------------------------------------------------------------------
+    // make multiple predictions of all predictors (classes) into row-major matrix
+    // scores[0, rows * numPredictors())
+    //------------------------------------------------------------------------------
+    void predictMatrix(const std::vector<Data>& data, float* scores, const size_t size, const bool outputMargin = false) const
+    {
+        if (m_model.predictors.size() == 1)
         {
-            const int group = tree_info[i];
-            if (group < 0)
-            {
-                throw std::runtime_error("unexpected tree_info group: " + std::to_string(group));
-            }
-
-            predictors.resize(predictors.size() < group + 1U ? group + 1U : predictors.size());
-
-            predictors[group].emplace_back(predictor[i]);
+            return predict(data, scores, size, outputMargin);
         }
 
-        // get objective and raw base score
-        const auto objective = getString(getObject(learner, "objective"), "name");
-        const auto base_score = std::stof(getString(getObject(learner, "learner_model_param"), "base_score"));
+        checkOutput(size, data.size() * m_model.predictors.size());
 
-        // transform base score according to the objective
-        auto transformBaseScore = [objective, base_score]()
+        profileRows(data.size(), [&data](const size_t row, const uint32_t feature, float& value)
         {
-            if (objective == "reg:logistic" || objective == "binary:logistic" || objective == "binary:logitraw")
+            return featureValue(data[row], feature, value);
+        });
+        const ProfileLatency latency(latencyCounters());
+
+        forEachBlock(data.size(), [this, &data, scores](const size_t begin, const size_t end)
+        {
+            predictFused(begin, end, scores, [this, &data](const size_t begin, const size_t end, const Tree* tree, float* scores)
             {
-                if (base_score <= 0.0f || base_score >= 1.0f)
+                predictTile(0, end - begin, tree, tree + 1, scores, [this, &data, begin](const size_t row, const Tree& tree)
                 {
-                    throw std::runtime_error("base_score must be in (0,1) for logistic loss, got: " + std::to_string(base_score));
-                }
-                return -std::log(1.0f / base_score - 1.0f);
-            }
-
-            if (objective == "reg:gamma" || objective == "reg:tweedie" || objective == "count:poisson" || objective == "survival:aft" || objective == "survival:cox")
+                    return predict(data[begin + row], tree);
+                });
+            },
+            [this, &data](const size_t row, const Predictor& predictor)
             {
-                return std::log(base_score);
-            }
+                return predict(data[row], predictor);
+            });
+        });
 
-            return base_score;
-        };
-
-        // get transformation according to the objective
+        if (!outputMargin)
+        {
+            transformMargins(scores, data.size() * m_model.predictors.size(), m_model.predictors.size());
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // make multiple predictions of all predictors (classes) from dense rows
+    // result is row-major matrix of rows x numPredictors() predictions
+    //------------------------------------------------------------------------------
+    std::vector<float> predictMatrix(const DenseData& data, const bool outputMargin = false) const
+    {
+        std::vector<float> scores(data.rows * m_model.predictors.size());
+        predictMatrix(data, scores.data(), scores.size(), outputMargin);
+        return scores;
+    }
+
+    //------------------------------------------------------------------------------
+    // make multiple predictions of all predictors (classes) from dense rows into
+    // row-major matrix scores[0, rows * numPredictors())
+    //------------------------------------------------------------------------------
+    void predictMatrix(const DenseData& data, float* scores, const size_t size, const bool outputMargin = false) const
+    {
+        if (m_model.predictors.size() == 1)
+        {
+            return predict(data, scores, size, outputMargin);
+        }
+
+        checkOutput(size, data.rows * m_model.predictors.size());
+
+        profileRows(data.rows, [&data](const size_t row, const uint32_t feature, float& value)
+        {
+            return featureValue(data.values + row * data.columns, data.columns, feature, value);
+        });
+        const ProfileLatency latency(latencyCounters());
+
+        const bool checked = data.columns < m_model.num_features;
+
+        forEachBlock(data.rows, [this, &data, scores, checked](const size_t begin, const size_t end)
+        {
+            predictFused(begin, end, scores, [this, &data, checked](const size_t begin, const size_t end, const Tree* tree, float* scores)
+            {
+                const float* rows = data.values + begin * data.columns;
+                if (checked)
+                {
+                    predictTile<true>(0, end - begin, tree, tree + 1, rows, data.columns, scores);
+                }
+                else
+                {
+                    predictTile<false>(0, end - begin, tree, tree + 1, rows, data.columns, scores);
+                }
+            },
+            [this, &data, checked](const size_t row, const Predictor& predictor)
+            {
+                const float* values = data.values + row * data.columns;
+                return checked ? predict<true>(values, data.columns, predictor) : predict<false>(values, data.columns, predictor);
+            });
+        });
+
+        if (!outputMargin)
+        {
+            transformMargins(scores, data.rows * m_model.predictors.size(), m_model.predictors.size());
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // number of predictors (classes), size of single row prediction
+    //------------------------------------------------------------------------------
+    size_t numPredictors() const
+    {
+        return m_model.predictors.size();
+    }
+
+    //------------------------------------------------------------------------------
+    // number of features used by the model (max feature index + 1)
+    // model features of remapped features (Options::remap_features, see remap)
+    //------------------------------------------------------------------------------
+    size_t numFeatures() const
+    {
+        return m_model.num_features;
+    }
+
+    //------------------------------------------------------------------------------
+    // row of model features from row of original features for models with remapped
+    // features (Options::remap_features): result[i] = data[model().features[i]]
+    // data is returned as is if features are not remapped
+    //------------------------------------------------------------------------------
+    Data remap(const Data& data) const
+    {
+        if (m_model.features.empty())
+        {
+            return data;
+        }
+
+        Data result(m_model.features.size());
+        for (size_t i = 0; i < result.size(); ++i)
+        {
+            if (m_model.features[i] < data.size())
+            {
+                result[i] = data[m_model.features[i]];
+            }
+        }
+        return result;
+    }
+
+    //------------------------------------------------------------------------------
+    // dense row of model features from dense row of original features into
+    // result[0, numFeatures()), size is capacity of result, NaN value is missing feature
+    //------------------------------------------------------------------------------
+    void remap(const float* data, const size_t size, float* result, const size_t resultSize) const
+    {
+        checkOutput(resultSize, m_model.num_features);
+
+        for (size_t i = 0; i < m_model.num_features; ++i)
+        {
+            const size_t feature = m_model.features.empty() ? i : m_model.features[i];
+            result[i] = feature < size ? data[feature] : std::numeric_limits<float>::quiet_NaN();
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // model compaction statistics (Options::compact, zero otherwise)
+    //------------------------------------------------------------------------------
+    const CompactionStats& compactionStats() const
+    {
+        return m_compactionStats;
+    }
+
+    //------------------------------------------------------------------------------
+    // tree-parallel single row prediction statistics
+    //------------------------------------------------------------------------------
+    TreeParallelStats treeParallelStats() const
+    {
+        TreeParallelStats stats;
+        stats.calls = m_treeParallelStats->calls;
+        stats.wall_ns = m_treeParallelStats->wall_ns;
+        stats.work_ns = m_treeParallelStats->work_ns;
+        stats.critical_ns = m_treeParallelStats->critical_ns;
+        return stats;
+    }
+
+    //------------------------------------------------------------------------------
+    // branch counts of nodes recorded with Options::count_hits (empty otherwise),
+    // [2 * i] yes and [2 * i + 1] no branch of model().nodes[i]
+    //------------------------------------------------------------------------------
+    std::vector<uint64_t> hitCounts() const
+    {
+        std::vector<uint64_t> result;
+
+        if (m_hitCounts)
+        {
+            result.reserve(m_hitCounts->size());
+            for (const auto& hits : *m_hitCounts)
+            {
+                result.push_back(hits.load(std::memory_order_relaxed));
+            }
+        }
+
+        return result;
+    }
+
+    //------------------------------------------------------------------------------
+    // clear branch counts
+    //------------------------------------------------------------------------------
+    void resetHitCounts() const
+    {
+        if (m_hitCounts)
+        {
+            for (auto& hits : *m_hitCounts)
+            {
+                hits.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // snapshot of hot path profile recorded with Options::profile or Options::profile_sample
+    // (empty otherwise), latency is recorded with profile, the other counters with profile_sample
+    // counters are cumulative, the difference of two snapshots profiles the time between
+    // each thread records into its own counters, the snapshot adds them up
+    //------------------------------------------------------------------------------
+    Profile profile() const
+    {
+        Profile result;
+
+        if (m_profile)
+        {
+            result.latency.assign(PROFILE_LATENCY_BUCKETS, 0);
+            result.rows.assign(m_model.predictors.size(), 0);
+            result.tree_nodes.assign(m_model.trees.size(), 0);
+            result.tree_ns.assign(m_model.trees.size(), 0);
+            result.feature_splits.assign(m_model.num_features, 0);
+            result.feature_missing.assign(m_model.num_features, 0);
+
+            auto merge = [](std::vector<uint64_t>& result, const std::vector<std::atomic<uint64_t>>& counters)
+            {
+                for (size_t i = 0; i < counters.size(); ++i)
+                {
+                    result[i] += counters[i].load(std::memory_order_relaxed);
+                }
+            };
+
+            const std::lock_guard<std::mutex> lock(m_profile->mutex);
+            for (const auto& counters : m_profile->threads)
+            {
+                merge(result.latency, counters->latency);
+                merge(result.rows, counters->rows);
+                merge(result.tree_nodes, counters->tree_nodes);
+                merge(result.tree_ns, counters->tree_ns);
+                merge(result.feature_splits, counters->feature_splits);
+                merge(result.feature_missing, counters->feature_missing);
+            }
+        }
+
+        return result;
+    }
+
+    //------------------------------------------------------------------------------
+    // write profile as JSON object of its counter arrays
+    //------------------------------------------------------------------------------
+    static void writeProfile(const Profile& profile, std::ostream& stream)
+    {
+        auto write = [&stream](const char* name, const std::vector<uint64_t>& counters, const char* separator)
+        {
+            stream << '"' << name << "\": [";
+            for (size_t i = 0; i < counters.size(); ++i)
+            {
+                stream << (i ? ", " : "") << counters[i];
+            }
+            stream << ']' << separator;
+        };
+
+        stream << '{';
+        write("latency", profile.latency, ", ");
+        write("rows", profile.rows, ", ");
+        write("tree_nodes", profile.tree_nodes, ", ");
+        write("tree_ns", profile.tree_ns, ", ");
+        write("feature_splits", profile.feature_splits, ", ");
+        write("feature_missing", profile.feature_missing, "");
+        stream << '}';
+    }
+
+    //------------------------------------------------------------------------------
+    // decide whether margin of single predictor model reaches cutoff (for probability p
+    // of sigmoid model: cutoff = log(p / (1 - p))), evaluation stops as soon as
+    // the bounds of the remaining trees decide it, exitAbove = false evaluates rows
+    // reaching the cutoff completely (e.g. top-k candidates, cutoff = k-th margin)
+    // the decision is the same as of the margin of predict(), except when predict()
+    // runs tree-parallel (Options::parallel_trees): its chunk sums may differ in the
+    // last bits from the sequential sum here, rows within a few ulps of the cutoff
+    // may be decided differently
+    //------------------------------------------------------------------------------
+    BoundedPrediction predictBounded(const Data& data, const float cutoff, const bool exitAbove = true) const
+    {
+        return predictBounded(cutoff, exitAbove, [this, &data](const Tree& tree)
+        {
+            return predict(data, tree);
+        });
+    }
+
+    //------------------------------------------------------------------------------
+    // decide whether margin of dense data reaches cutoff, NaN value is missing feature
+    //------------------------------------------------------------------------------
+    BoundedPrediction predictBounded(const float* data, const size_t size, const float cutoff, const bool exitAbove = true) const
+    {
+        if (size >= m_model.num_features)
+        {
+            return predictBounded(cutoff, exitAbove, [this, data, size](const Tree& tree)
+            {
+                return predict<false>(data, size, tree);
+            });
+        }
+
+        return predictBounded(cutoff, exitAbove, [this, data, size](const Tree& tree)
+        {
+            return predict<true>(data, size, tree);
+        });
+    }
+
+    //------------------------------------------------------------------------------
+    // residual predictor for rows sharing values of features[0, count) (e.g. query
+    // features of ranking candidates), NaN value is missing feature
+    // decision nodes on shared features are resolved once: every tree is reduced to
+    // its residual subtree on the other features, or a single leaf node when it
+    // splits on shared features only, trees keep their order
+    // rows scored by the residual predictor get the same predictions as with the
+    // shared values set, their own values of shared features are ignored
+    // the residual predictor takes rows of the same features (features are not remapped again)
+    //------------------------------------------------------------------------------
+    XGBoostPredictor specialize(const uint32_t* features, const float* values, const size_t count) const
+    {
+        Options options = m_options;
+        options.remap_features = false;
+        return XGBoostPredictor(specialize(m_model, features, values, count), options);
+    }
+
+    //------------------------------------------------------------------------------
+    // output transformation of margins[0, size) of rows of columns predictions as of
+    // predict(): expf and softmax sums in double like the std::vector overloads of
+    // transform, or with Options::fast_transform vectorized like the raw buffer
+    // overloads (within 1 ulp of expf, 0 below -86.9, softmax sums in float)
+    //------------------------------------------------------------------------------
+    void transformMargins(float* margins, const size_t size, const size_t columns) const
+    {
+        if (m_options.fast_transform)
+        {
+            transform(margins, size, columns, m_model.transformation);
+        }
+        else
+        {
+            transformOutput(margins, size, columns, m_model.transformation);
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // output margin transformation according to the objective
+    // std::vector overloads compute expf (softmax sums in double) like the outputs
+    // of predict(), raw buffer and span overloads are vectorized (see exponential)
+    //------------------------------------------------------------------------------
+    static void transform(std::vector<float>& predictions, const Transformation transformation)
+    {
+        transformOutput(predictions.data(), predictions.size(), predictions.size(), transformation);
+    }
+
+    //------------------------------------------------------------------------------
+    // output margin transformation of row-major matrix with columns predictions per row
+    //------------------------------------------------------------------------------
+    static void transform(std::vector<float>& predictions, const size_t columns, const Transformation transformation)
+    {
+        checkColumns(predictions.size(), columns);
+        transformOutput(predictions.data(), predictions.size(), columns, transformation);
+    }
+
+    //------------------------------------------------------------------------------
+    // vectorized output margin transformation of predictions[0, size) according to the objective
+    //------------------------------------------------------------------------------
+    static void transform(float* predictions, const size_t size, const Transformation transformation)
+    {
+        if (size == 0)
+        {
+            return;
+        }
+
+        if (transformation == Transformation::SIGMOID)
+        {
+            transformSigmoid(predictions, size);
+        }
+        else if (transformation == Transformation::SOFTMAX)
+        {
+            transformSoftmax(predictions, size);
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // vectorized output margin transformation of row-major matrix predictions[0, size)
+    // with columns predictions per row, size is a multiple of columns
+    //------------------------------------------------------------------------------
+    static void transform(float* predictions, const size_t size, const size_t columns, const Transformation transformation)
+    {
+        checkColumns(size, columns);
+
+        if (transformation == Transformation::SOFTMAX && columns > 0)
+        {
+            transformSoftmax(predictions, size / columns, columns);
+        }
+        else
+        {
+            transform(predictions, size, transformation);
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // sigmoid transformation
+    //------------------------------------------------------------------------------
+    static void transformSigmoid(std::vector<float>& predictions)
+    {
+        transformOutput(predictions.data(), predictions.size(), predictions.size(), Transformation::SIGMOID);
+    }
+
+    //------------------------------------------------------------------------------
+    // vectorized sigmoid transformation of predictions[0, size)
+    //------------------------------------------------------------------------------
+    static void transformSigmoid(float* predictions, const size_t size)
+    {
+        exponential<true>(predictions, size);
+    }
+
+    //------------------------------------------------------------------------------
+    // softmax transformation
+    //------------------------------------------------------------------------------
+    static void transformSoftmax(std::vector<float>& predictions)
+    {
+        transformOutput(predictions.data(), predictions.size(), predictions.size(), Transformation::SOFTMAX);
+    }
+
+    //------------------------------------------------------------------------------
+    // vectorized softmax transformation of predictions[0, size)
+    //------------------------------------------------------------------------------
+    static void transformSoftmax(float* predictions, const size_t size)
+    {
+        if (size > 0)
+        {
+            transformSoftmax(predictions, 1, size);
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // vectorized softmax transformation of each row of row-major matrix
+    // whole matrix passes (max, exp, sum, scale) run over contiguous memory,
+    // so that the compiler can vectorize them
+    //------------------------------------------------------------------------------
+    static void transformSoftmax(float* predictions, const size_t rows, const size_t columns)
+    {
+        if (columns == 0)
+        {
+            return;
+        }
+
+        constexpr size_t BLOCK = 256;   // rows of block, row maxima/sums stay on stack
+
+        float max[BLOCK];
+        float sum[BLOCK];
+
+        for (size_t begin = 0; begin < rows; begin += BLOCK)
+        {
+            const size_t count = std::min(BLOCK, rows - begin);
+            float* block = predictions + begin * columns;
+
+            for (size_t row = 0; row < count; ++row)
+            {
+                const float* values = block + row * columns;
+                float value = values[0];
+                for (size_t column = 1; column < columns; ++column)
+                {
+                    value = std::max(value, values[column]);
+                }
+                max[row] = value;
+            }
+
+            for (size_t row = 0; row < count; ++row)
+            {
+                float* values = block + row * columns;
+                for (size_t column = 0; column < columns; ++column)
+                {
+                    values[column] -= max[row];
+                }
+            }
+
+            exponential<false>(block, count * columns);
+
+            for (size_t row = 0; row < count; ++row)
+            {
+                const float* values = block + row * columns;
+                float value = 0.0f;
+                for (size_t column = 0; column < columns; ++column)
+                {
+                    value += values[column];
+                }
+                sum[row] = 1.0f / value;
+            }
+
+            for (size_t row = 0; row < count; ++row)
+            {
+                float* values = block + row * columns;
+                for (size_t column = 0; column < columns; ++column)
+                {
+                    values[column] *= sum[row];
+                }
+            }
+        }
+    }
+
+#ifdef __cpp_lib_span
+    //------------------------------------------------------------------------------
+    // output margin transformation of span according to the objective
+    //------------------------------------------------------------------------------
+    static void transform(const std::span<float> predictions, const Transformation transformation)
+    {
+        transform(predictions.data(), predictions.size(), transformation);
+    }
+
+    //------------------------------------------------------------------------------
+    // output margin transformation of row-major matrix span with columns predictions per row
+    //------------------------------------------------------------------------------
+    static void transform(const std::span<float> predictions, const size_t columns, const Transformation transformation)
+    {
+        transform(predictions.data(), predictions.size(), columns, transformation);
+    }
+
+    //------------------------------------------------------------------------------
+    // sigmoid transformation of span
+    //------------------------------------------------------------------------------
+    static void transformSigmoid(const std::span<float> predictions)
+    {
+        transformSigmoid(predictions.data(), predictions.size());
+    }
+
+    //------------------------------------------------------------------------------
+    // softmax transformation of span
+    //------------------------------------------------------------------------------
+    static void transformSoftmax(const std::span<float> predictions)
+    {
+        transformSoftmax(predictions.data(), predictions.size());
+    }
+#endif
+
+    // incremental scoring session of one dense row (NaN value is missing feature)
+    // leaf values of all trees are cached, an update re-traverses only the trees
+    // splitting on changed features (feature to tree index of predictor), margins of
+    // their predictors are summed again from cached leaves in tree order, so
+    // predictions are identical to sequential predict() of the updated row
+    // a session is not thread-safe, its predictor must outlive it
+    class Session
+    {
+    public:
+        //------------------------------------------------------------------------------
+        // create session scoring dense row of size values
+        //------------------------------------------------------------------------------
+        Session(const XGBoostPredictor& predictor, const float* data, const size_t size)
+            :m_predictor(predictor)
+            ,m_leaves(predictor.m_model.trees.size())
+            ,m_treeStamps(predictor.m_model.trees.size())
+            ,m_margins(predictor.m_model.predictors.size())
+            ,m_predictorStamps(predictor.m_model.predictors.size())
+        {
+            reset(data, size);
+        }
+
+        //------------------------------------------------------------------------------
+        // score another row, buffers of session are reused
+        //------------------------------------------------------------------------------
+        void reset(const float* data, const size_t size)
+        {
+            const auto& model = m_predictor.m_model;
+
+            m_row.assign(std::max<size_t>(size, model.num_features), std::numeric_limits<float>::quiet_NaN());
+            std::copy(data, data + size, m_row.begin());
+
+            for (uint32_t tree = 0; tree < m_leaves.size(); ++tree)
+            {
+                m_leaves[tree] = traverse(tree);
+            }
+
+            for (uint32_t predictor = 0; predictor < m_margins.size(); ++predictor)
+            {
+                sum(predictor);
+            }
+        }
+
+        //------------------------------------------------------------------------------
+        // set feature value (NaN for missing) and rescore
+        // returns number of trees traversed again
+        //------------------------------------------------------------------------------
+        size_t update(const uint32_t feature, const float value)
+        {
+            return update(&feature, &value, 1);
+        }
+
+        //------------------------------------------------------------------------------
+        // set values of features[0, count) and rescore, trees splitting on several
+        // changed features are traversed once
+        // returns number of trees traversed again
+        //------------------------------------------------------------------------------
+        size_t update(const uint32_t* features, const float* values, const size_t count)
+        {
+            const auto& index = m_predictor.m_featureIndex;
+            const uint32_t numFeatures = index.offsets.size() - 1;
+
+            ++m_stamp;
+            m_trees.clear();
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                // features not used by the model do not change any tree
+                const uint32_t feature = features[i];
+                if (feature >= numFeatures)
+                {
+                    continue;
+                }
+
+                float& value = m_row[feature];
+                if (value == values[i] || (std::isnan(value) && std::isnan(values[i])))
+                {
+                    continue;
+                }
+                value = values[i];
+
+                for (uint32_t j = index.offsets[feature]; j < index.offsets[feature + 1]; ++j)
+                {
+                    const uint32_t tree = index.trees[j];
+                    if (m_treeStamps[tree] != m_stamp)
+                    {
+                        m_treeStamps[tree] = m_stamp;
+                        m_trees.push_back(tree);
+                    }
+                }
+            }
+
+            // traverse after all values are set, sum predictors with changed leaves
+            m_predictors.clear();
+            for (const uint32_t tree : m_trees)
+            {
+                const float leaf = traverse(tree);
+                if (leaf == m_leaves[tree])
+                {
+                    continue;
+                }
+                m_leaves[tree] = leaf;
+
+                const uint32_t predictor = index.predictors[tree];
+                if (m_predictorStamps[predictor] != m_stamp)
+                {
+                    m_predictorStamps[predictor] = m_stamp;
+                    m_predictors.push_back(predictor);
+                }
+            }
+
+            for (const uint32_t predictor : m_predictors)
+            {
+                sum(predictor);
+            }
+
+            return m_trees.size();
+        }
+
+        //------------------------------------------------------------------------------
+        // prediction of current row
+        //------------------------------------------------------------------------------
+        std::vector<float> predict(const bool outputMargin = false) const
+        {
+            std::vector<float> predictions(m_margins.size());
+            predict(predictions.data(), predictions.size(), outputMargin);
+            return predictions;
+        }
+
+        //------------------------------------------------------------------------------
+        // prediction of current row into predictions[0, numPredictors())
+        //------------------------------------------------------------------------------
+        void predict(float* predictions, const size_t size, const bool outputMargin = false) const
+        {
+            checkOutput(size, m_margins.size());
+
+            std::copy(m_margins.begin(), m_margins.end(), predictions);
+
+            if (!outputMargin)
+            {
+                m_predictor.transformMargins(predictions, m_margins.size(), m_margins.size());
+            }
+        }
+
+        //------------------------------------------------------------------------------
+        // current row, at least numFeatures() values
+        //------------------------------------------------------------------------------
+        const std::vector<float>& row() const
+        {
+            return m_row;
+        }
+
+    private:
+        //------------------------------------------------------------------------------
+        // leaf value of tree for current row
+        //------------------------------------------------------------------------------
+        float traverse(const uint32_t tree) const
+        {
+            return m_predictor.predict<false>(m_row.data(), m_row.size(), m_predictor.m_model.trees[tree]);
+        }
+
+        //------------------------------------------------------------------------------
+        // margin of predictor from cached leaves, summed like sequential predict()
+        //------------------------------------------------------------------------------
+        void sum(const uint32_t predictor)
+        {
+            const auto& range = m_predictor.m_model.predictors[predictor];
+
+            float margin = 0.0f;
+            for (uint32_t tree = range.begin; tree < range.end; ++tree)
+            {
+                margin += m_leaves[tree];
+            }
+
+            m_margins[predictor] = margin + m_predictor.m_model.base_score;
+        }
+
+    private:
+        const XGBoostPredictor& m_predictor;
+        std::vector<float> m_row;
+        std::vector<float> m_leaves;                // cached leaf value of each tree
+        std::vector<uint64_t> m_treeStamps;         // update stamp of tree, marks trees to traverse once
+        std::vector<float> m_margins;               // margin of each predictor
+        std::vector<uint64_t> m_predictorStamps;    // update stamp of predictor, marks predictors to sum once
+        uint64_t m_stamp = 0;                       // current update
+        std::vector<uint32_t> m_trees;              // trees traversed by update
+        std::vector<uint32_t> m_predictors;         // predictors summed by update
+    };
+
+
+public:
+    // compiled model, read-only access for tools built on the predictor
+
+    // decision node of tree, packed in the model node arena
+    // leaf children are stored inline in their parent, default (missing value) direction is a flag
+    struct Node
+    {
+        static constexpr uint32_t FEATURE_MASK = 0x1fffffffU;  // feature index bits of info
+        static constexpr uint32_t YES_LEAF = 1U << 29;          // yes child is leaf
+        static constexpr uint32_t NO_LEAF = 1U << 30;           // no child is leaf
+        static constexpr uint32_t DEFAULT_LEFT = 1U << 31;      // missing feature follows yes child
+
+        // child node arena offset or leaf value
+        union Child
+        {
+            uint32_t offset;
+            float value;
+        };
+
+        float value = 0.0f;         // threshold value, if (feature < value) next = children[0] else next = children[1]
+        uint32_t info = 0;          // feature index and flags
+        Child children[2] = {};     // yes/no children
+
+        uint32_t feature() const
+        {
+            return info & FEATURE_MASK;
+        }
+
+        bool defaultLeft() const
+        {
+            return info & DEFAULT_LEFT;
+        }
+
+        bool isLeaf(const unsigned int child) const
+        {
+            return info & (child ? NO_LEAF : YES_LEAF);
+        }
+    };
+
+    // cache line aligned allocator for node arena
+    template<typename T, size_t Alignment = 64>
+    struct AlignedAllocator
+    {
+        using value_type = T;
+
+        template<typename U>
+        struct rebind
+        {
+            using other = AlignedAllocator<U, Alignment>;
+        };
+
+        AlignedAllocator() = default;
+
+        template<typename U>
+        AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+        T* allocate(const size_t n)
+        {
+            return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+        }
+
+        void deallocate(T* p, const size_t)
+        {
+            ::operator delete(p, std::align_val_t(Alignment));
+        }
+
+        bool operator==(const AlignedAllocator&) const { return true; }
+        bool operator!=(const AlignedAllocator&) const { return false; }
+    };
+
+    // contiguous storage of decision nodes of all trees, used while building the model
+    using Arena = std::vector<Node, AlignedAllocator<Node>>;
+
+    // read-only array of model items, owned or referring to mapped binary model file
+    // copies share the items
+    template<typename T>
+    class Array
+    {
+    public:
+        Array() = default;
+
+        // take over items of vector
+        template<typename Allocator>
+        explicit Array(std::vector<T, Allocator>&& items)
+        {
+            const auto storage = std::make_shared<std::vector<T, Allocator>>(std::move(items));
+            m_data = storage->data();
+            m_size = storage->size();
+            m_storage = storage;
+        }
+
+        // refer to items kept alive by storage
+        Array(const T* data, const size_t size, std::shared_ptr<const void> storage)
+            :m_data(data)
+            ,m_size(size)
+            ,m_storage(std::move(storage))
+        {}
+
+        const T* data() const { return m_data; }
+        size_t size() const { return m_size; }
+        bool empty() const { return m_size == 0; }
+        const T* begin() const { return m_data; }
+        const T* end() const { return m_data + m_size; }
+        const T& front() const { return m_data[0]; }
+        const T& operator[](const size_t i) const { return m_data[i]; }
+
+    private:
+        const T* m_data = nullptr;
+        size_t m_size = 0;
+        std::shared_ptr<const void> m_storage;
+    };
+
+    // tree: offset of root node in arena
+    struct Tree
+    {
+        uint32_t root = 0;
+    };
+
+    // predictor: range of trees in model tree table
+    struct Predictor
+    {
+        uint32_t begin = 0;
+        uint32_t end = 0;
+    };
+
+    // model: multiple predictors for multiclass prediction
+    //        trees of all predictors, grouped by predictor, packed in one node arena
+    //        decision nodes of a tree are in preorder, children follow their parent
+    //        (compacted models: or are a subtree shared with an earlier tree)
+    //        transformed base score (according to the objective)
+    //        original feature index of model features when features are remapped
+    struct Model
+    {
+        Array<Node> nodes;
+        Array<Tree> trees;
+        Array<Predictor> predictors;
+        Array<uint32_t> features;
+        uint32_t num_features = 0;
+        float base_score = 0.0f;
+        Transformation transformation = Transformation::NONE;
+    };
+
+    //------------------------------------------------------------------------------
+    // compiled model
+    //------------------------------------------------------------------------------
+    const Model& model() const
+    {
+        return m_model;
+    }
+
+
+private:
+    // tree node as stored in model file, used while loading the model
+    struct ParsedNode
+    {
+        float value = 0.0f;         // threshold value for decision node, leaf value for leaf node
+        int feature = -1;           // feature index for decision node, -1 for leaf node
+        unsigned int yes = 0;       // if (feature < value) next node index = yes
+        unsigned int no = 0;        // if (feature >= value) next node index = no
+        bool default_left = false;  // if (feature is missing) next node index = default_left ? yes : no
+        float cover = 0.0f;         // sum_hessian of training samples reaching the node (Layout::COVER), 0 otherwise
+    };
+
+    // tree as stored in model file
+    using ParsedTree = std::vector<ParsedNode>;
+
+    // reusable buffers of tree check and packing
+    struct TreeScratch
+    {
+        std::vector<unsigned int> stack;
+        std::vector<unsigned int> order;    // decision nodes in preorder
+        std::vector<uint8_t> visited;
+        std::vector<uint32_t> offsets;      // arena offsets of decision nodes
+    };
+
+    // model being loaded: trees packed into node arena in model file order
+    struct ModelBuilder
+    {
+        Arena nodes;
+        std::vector<Tree> trees;
+        uint32_t num_features = 0;
+        std::vector<int> tree_info;
+        std::string objective;
+        std::string base_score;
+    };
+
+    // SAX handler of JSON model: reads learner objective/base score, trees and
+    // tree_info of learner.gradient_booster.model, all other members are skipped
+    // trees read are collected in batches of bounded size, a batch is checked and
+    // packed (in parallel on executor, if any) and appended in model file order
+    class JsonHandler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, JsonHandler>
+    {
+    public:
+        std::string error;  // error of failed parse, empty for invalid json
+
+        // cover: read sum_hessian of tree nodes (Layout::COVER)
+        JsonHandler(Executor* executor, const bool cover)
+            :m_executor(executor)
+            ,m_cover(cover)
+        {}
+
+        bool Null() { return scalar(); }
+        bool Bool(const bool value)
+        {
+            if (context() == Context::DEFAULT_LEFT)
+            {
+                m_default_left.push_back(value);
+                return true;
+            }
+            return scalar();
+        }
+        bool Int(const int value) { return integer(value); }
+        bool Uint(const unsigned int value) { return integer(value); }
+        bool Int64(const int64_t value) { return integer(value); }
+        bool Uint64(const uint64_t value) { return value <= static_cast<uint64_t>(std::numeric_limits<int64_t>::max()) ? integer(value) : number(value); }
+        bool Double(const double value) { return number(value); }
+
+        bool String(const char* value, const rapidjson::SizeType length, bool)
+        {
+            if (context() == Context::OBJECTIVE && m_key == "name")
+            {
+                m_builder.objective.assign(value, length);
+                m_found |= OBJECTIVE_NAME;
+                return true;
+            }
+            if (context() == Context::MODEL_PARAM && m_key == "base_score")
+            {
+                m_builder.base_score.assign(value, length);
+                m_found |= BASE_SCORE;
+                return true;
+            }
+            return scalar();
+        }
+
+        bool Key(const char* key, const rapidjson::SizeType length, bool)
+        {
+            m_key.assign(key, length);
+            return true;
+        }
+
+        //------------------------------------------------------------------------------
+        // typed array values (UBJSON), int32/float32 tree arrays are copied in bulk
+        //------------------------------------------------------------------------------
+        template<typename T>
+        bool Values(const T* values, const size_t count)
+        {
+            const Context context = this->context();
+
+            if constexpr (std::is_same<T, int32_t>::value)
+            {
+                if (context >= Context::LEFT_CHILDREN && context <= Context::SPLIT_INDICES)
+                {
+                    auto& array = context == Context::LEFT_CHILDREN ? m_left_children : context == Context::RIGHT_CHILDREN ? m_right_children : m_split_indices;
+                    array.insert(array.end(), values, values + count);
+                    return true;
+                }
+            }
+
+            if constexpr (std::is_same<T, float>::value)
+            {
+                if (context == Context::SPLIT_CONDITIONS || context == Context::SUM_HESSIAN)
+                {
+                    auto& array = context == Context::SPLIT_CONDITIONS ? m_split_conditions : m_sum_hessian;
+                    array.insert(array.end(), values, values + count);
+                    return true;
+                }
+            }
+
+            if (context == Context::SKIP)
+            {
+                return true;
+            }
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                bool result = false;
+                if constexpr (std::is_floating_point<T>::value)
+                {
+                    result = number(values[i]);
+                }
+                else
+                {
+                    result = integer(static_cast<int64_t>(values[i]));
+                }
+
+                if (!result)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool StartObject() { return start(true); }
+        bool EndObject(rapidjson::SizeType) { return end(); }
+        bool StartArray() { return start(false); }
+        bool EndArray(rapidjson::SizeType) { return end(); }
+
+        //------------------------------------------------------------------------------
+        // loaded model, throws if required member is missing
+        //------------------------------------------------------------------------------
+        ModelBuilder&& finish()
+        {
+            flush();
+
+            const std::pair<uint32_t, const char*> required[] = {
+                {LEARNER, "missing or invalid json value member: learner"},
+                {BOOSTER, "missing or invalid json value member: gradient_booster"},
+                {MODEL, "missing or invalid json value member: model"},
+                {TREES, "missing or invalid json array member: trees"},
+                {TREE_INFO, "missing or invalid json array member: tree_info"},
+                {OBJECTIVE, "missing or invalid json value member: objective"},
+                {OBJECTIVE_NAME, "missing or invalid json string member: name"},
+                {MODEL_PARAM, "missing or invalid json value member: learner_model_param"},
+                {BASE_SCORE, "missing or invalid json string member: base_score"}};
+
+            for (const auto& member : required)
+            {
+                if (!(m_found & member.first))
+                {
+                    throw std::runtime_error(member.second);
+                }
+            }
+
+            return std::move(m_builder);
+        }
+
+    private:
+        // json container being read
+        enum class Context
+        {
+            ROOT,
+            LEARNER,
+            OBJECTIVE,
+            MODEL_PARAM,
+            BOOSTER,
+            MODEL,
+            TREES,
+            TREE,
+            DEFAULT_LEFT,
+            LEFT_CHILDREN,
+            RIGHT_CHILDREN,
+            SPLIT_INDICES,
+            SPLIT_CONDITIONS,
+            SUM_HESSIAN,
+            TREE_INFO,
+            SKIP
+        };
+
+        // found members
+        static constexpr uint32_t LEARNER = 1U << 0;
+        static constexpr uint32_t BOOSTER = 1U << 1;
+        static constexpr uint32_t MODEL = 1U << 2;
+        static constexpr uint32_t TREES = 1U << 3;
+        static constexpr uint32_t TREE_INFO = 1U << 4;
+        static constexpr uint32_t OBJECTIVE = 1U << 5;
+        static constexpr uint32_t OBJECTIVE_NAME = 1U << 6;
+        static constexpr uint32_t MODEL_PARAM = 1U << 7;
+        static constexpr uint32_t BASE_SCORE = 1U << 8;
+
+        Context context() const
+        {
+            return m_stack.empty() ? Context::SKIP : m_stack.back();
+        }
+
+        //------------------------------------------------------------------------------
+        // enter object/array
+        //------------------------------------------------------------------------------
+        bool start(const bool object)
+        {
+            Context next = Context::SKIP;
+
+            if (m_stack.empty())
+            {
+                if (!object)
+                {
+                    return false;
+                }
+                next = Context::ROOT;
+            }
+            else
+            {
+                next = child(context(), object);
+            }
+
+            m_found |= member(next);
+
+            if (next == Context::TREE)
+            {
+                m_fields = 0;
+                m_default_left.clear();
+                m_left_children.clear();
+                m_right_children.clear();
+                m_split_indices.clear();
+                m_split_conditions.clear();
+                m_sum_hessian.clear();
+            }
+
+            m_stack.push_back(next);
+            return true;
+        }
+
+        //------------------------------------------------------------------------------
+        // context of object/array (member m_key of object) in parent context
+        //------------------------------------------------------------------------------
+        Context child(const Context parent, const bool object) const
+        {
+            switch (parent)
+            {
+                case Context::ROOT:
+                    return object && m_key == "learner" ? Context::LEARNER : Context::SKIP;
+                case Context::LEARNER:
+                    if (object && m_key == "objective")
+                    {
+                        return Context::OBJECTIVE;
+                    }
+                    if (object && m_key == "learner_model_param")
+                    {
+                        return Context::MODEL_PARAM;
+                    }
+                    return object && m_key == "gradient_booster" ? Context::BOOSTER : Context::SKIP;
+                case Context::BOOSTER:
+                    return object && m_key == "model" ? Context::MODEL : Context::SKIP;
+                case Context::MODEL:
+                    if (!object && m_key == "trees")
+                    {
+                        return Context::TREES;
+                    }
+                    return !object && m_key == "tree_info" ? Context::TREE_INFO : Context::SKIP;
+                case Context::TREES:
+                    return object ? Context::TREE : Context::SKIP;
+                case Context::TREE:
+                    if (object)
+                    {
+                        return Context::SKIP;
+                    }
+                    if (m_key == "default_left")
+                    {
+                        return Context::DEFAULT_LEFT;
+                    }
+                    if (m_key == "left_children")
+                    {
+                        return Context::LEFT_CHILDREN;
+                    }
+                    if (m_key == "right_children")
+                    {
+                        return Context::RIGHT_CHILDREN;
+                    }
+                    if (m_key == "split_indices")
+                    {
+                        return Context::SPLIT_INDICES;
+                    }
+                    if (m_cover && m_key == "sum_hessian")
+                    {
+                        return Context::SUM_HESSIAN;
+                    }
+                    return m_key == "split_conditions" ? Context::SPLIT_CONDITIONS : Context::SKIP;
+                default:
+                    return Context::SKIP;
+            }
+        }
+
+        //------------------------------------------------------------------------------
+        // found member flag of context
+        //------------------------------------------------------------------------------
+        static uint32_t member(const Context context)
+        {
+            switch (context)
+            {
+                case Context::LEARNER:
+                    return LEARNER;
+                case Context::OBJECTIVE:
+                    return OBJECTIVE;
+                case Context::MODEL_PARAM:
+                    return MODEL_PARAM;
+                case Context::BOOSTER:
+                    return BOOSTER;
+                case Context::MODEL:
+                    return MODEL;
+                case Context::TREES:
+                    return TREES;
+                case Context::TREE_INFO:
+                    return TREE_INFO;
+                default:
+                    return 0;
+            }
+        }
+
+        //------------------------------------------------------------------------------
+        // leave object/array
+        //------------------------------------------------------------------------------
+        bool end()
+        {
+            const Context context = m_stack.back();
+            m_stack.pop_back();
+
+            if (context >= Context::DEFAULT_LEFT && context <= Context::SUM_HESSIAN)
+            {
+                m_fields |= 1U << (static_cast<unsigned int>(context) - static_cast<unsigned int>(Context::DEFAULT_LEFT));
+            }
+            else if (context == Context::TREE)
+            {
+                return run([this]()
+                {
+                    tree();
+                });
+            }
+
+            return true;
+        }
+
+        //------------------------------------------------------------------------------
+        // integer value
+        //------------------------------------------------------------------------------
+        bool integer(const int64_t value)
+        {
+            std::vector<int>* array = nullptr;
+            const char* key = nullptr;
+
+            switch (context())
+            {
+                case Context::DEFAULT_LEFT:
+                    if (value != 0 && value != 1)
+                    {
+                        error = "default_left json array member is not bool";
+                        return false;
+                    }
+                    m_default_left.push_back(value);
+                    return true;
+                case Context::LEFT_CHILDREN:
+                    array = &m_left_children;
+                    key = "left_children";
+                    break;
+                case Context::RIGHT_CHILDREN:
+                    array = &m_right_children;
+                    key = "right_children";
+                    break;
+                case Context::SPLIT_INDICES:
+                    array = &m_split_indices;
+                    key = "split_indices";
+                    break;
+                case Context::TREE_INFO:
+                    array = &m_builder.tree_info;
+                    key = "tree_info";
+                    break;
+                case Context::SPLIT_CONDITIONS:
+                    m_split_conditions.push_back(value);
+                    return true;
+                case Context::SUM_HESSIAN:
+                    m_sum_hessian.push_back(value);
+                    return true;
+                default:
+                    return scalar();
+            }
+
+            if (value < std::numeric_limits<int>::min() || value > std::numeric_limits<int>::max())
+            {
+                error = std::string(key) + " json array member is not int";
+                return false;
+            }
+
+            array->push_back(static_cast<int>(value));
+            return true;
+        }
+
+        //------------------------------------------------------------------------------
+        // floating point value
+        //------------------------------------------------------------------------------
+        bool number(const double value)
+        {
+            if (context() == Context::SPLIT_CONDITIONS || context() == Context::SUM_HESSIAN)
+            {
+                (context() == Context::SPLIT_CONDITIONS ? m_split_conditions : m_sum_hessian).push_back(value);
+                return true;
+            }
+            return scalar();
+        }
+
+        //------------------------------------------------------------------------------
+        // other scalar value: invalid in tree arrays, skipped elsewhere
+        //------------------------------------------------------------------------------
+        bool scalar()
+        {
+            static const char* const errors[] = {
+                "default_left json array member is not bool",
+                "left_children json array member is not int",
+                "right_children json array member is not int",
+                "split_indices json array member is not int",
+                "split_conditions json array member is not double/int",
+                "sum_hessian json array member is not double/int"};
+
+            const Context context = this->context();
+            if (context >= Context::DEFAULT_LEFT && context <= Context::SUM_HESSIAN)
+            {
+                error = errors[static_cast<unsigned int>(context) - static_cast<unsigned int>(Context::DEFAULT_LEFT)];
+                return false;
+            }
+            if (context == Context::TREE_INFO)
+            {
+                error = "tree_info json array member is not int";
+                return false;
+            }
+            return true;
+        }
+
+        //------------------------------------------------------------------------------
+        // check and pack tree read
+        //------------------------------------------------------------------------------
+        void tree()
+        {
+            static const char* const names[] = {"default_left", "left_children", "right_children", "split_indices", "split_conditions"};
+            for (unsigned int i = 0; i < 5; ++i)
+            {
+                if (!(m_fields & (1U << i)))
+                {
+                    throw std::runtime_error("missing or invalid json array member: " + std::string(names[i]));
+                }
+            }
+
+            checkSizes(m_default_left.size(), m_left_children.size(), m_right_children.size(), m_split_indices.size(), m_split_conditions.size());
+
+            // optional node covers
+            const bool cover = m_fields & (1U << 5);
+            if (cover)
+            {
+                checkSizes(m_default_left.size(), m_sum_hessian.size());
+            }
+
+            // batch trees keep their buffers between batches
+            if (m_trees == m_batch.size())
+            {
+                m_batch.emplace_back();
+            }
+            auto& tree = m_batch[m_trees++];
+
+            tree.resize(m_default_left.size());
+            for (size_t i = 0; i < tree.size(); ++i)
+            {
+                auto& node = tree[i];
+                node.value = m_split_conditions[i];
+                node.feature = m_left_children[i] >= 0 ? m_split_indices[i] : -1;
+                node.yes = m_left_children[i];
+                node.no = m_right_children[i];
+                node.default_left = m_default_left[i];
+                node.cover = cover ? m_sum_hessian[i] : 0.0f;
+            }
+
+            m_batchNodes += tree.size();
+            if (m_batchNodes >= BATCH_NODES)
+            {
+                flush();
+            }
+        }
+
+        //------------------------------------------------------------------------------
+        // check and pack batch of trees, append them to model
+        //------------------------------------------------------------------------------
+        void flush()
+        {
+            const size_t trees = m_trees;
+            m_trees = 0;
+            m_batchNodes = 0;
+
+            if (!m_executor || m_executor->concurrency() < 2 || trees < 2)
+            {
+                for (size_t i = 0; i < trees; ++i)
+                {
+                    check(m_batch[i], m_scratch);
+                    m_builder.trees.push_back(pack(m_batch[i], m_scratch, m_builder.nodes, m_builder.num_features));
+                }
+                return;
+            }
+
+            // chunks of consecutive trees are packed into chunk arenas
+            m_chunks.resize(std::min(trees, m_executor->concurrency() * 4));
+            const size_t chunks = m_chunks.size();
+
+            m_executor->parallelFor(chunks, [this, trees, chunks](const size_t i)
+            {
+                auto& chunk = m_chunks[i];
+                chunk.nodes.clear();
+                chunk.trees.clear();
+                chunk.num_features = 0;
+                chunk.error = nullptr;
+
+                try
+                {
+                    for (size_t tree = trees * i / chunks; tree < trees * (i + 1) / chunks; ++tree)
+                    {
+                        check(m_batch[tree], chunk.scratch);
+                        chunk.trees.push_back(pack(m_batch[tree], chunk.scratch, chunk.nodes, chunk.num_features));
+                    }
+                }
+                catch (...)
+                {
+                    chunk.error = std::current_exception();
+                }
+            });
+
+            // append in model file order, error of first invalid tree is reported
+            for (const auto& chunk : m_chunks)
+            {
+                if (chunk.error)
+                {
+                    std::rethrow_exception(chunk.error);
+                }
+
+                const uint32_t base = relocate(chunk.nodes.data(), chunk.nodes.size(), 0, m_builder.nodes);
+                for (const auto& tree : chunk.trees)
+                {
+                    m_builder.trees.push_back(Tree{base + tree.root});
+                }
+                m_builder.num_features = std::max(m_builder.num_features, chunk.num_features);
+            }
+        }
+
+        //------------------------------------------------------------------------------
+        // run action, exception stops parsing with error
+        //------------------------------------------------------------------------------
+        template<typename Action>
+        bool run(const Action& action)
+        {
+            try
+            {
+                action();
+                return true;
+            }
+            catch (const std::exception& e)
+            {
+                error = e.what();
+                return false;
+            }
+        }
+
+    private:
+        std::vector<Context> m_stack;
+        std::string m_key;
+        uint32_t m_found = 0;
+
+        // arrays of current tree
+        uint32_t m_fields = 0;
+        std::vector<bool> m_default_left;
+        std::vector<int> m_left_children;
+        std::vector<int> m_right_children;
+        std::vector<int> m_split_indices;
+        std::vector<float> m_split_conditions;
+        std::vector<float> m_sum_hessian;
+
+        // batch of trees to check and pack
+        static constexpr size_t BATCH_NODES = 1U << 16;
+
+        // trees of batch packed by a task
+        struct Chunk
+        {
+            Arena nodes;
+            std::vector<Tree> trees;
+            uint32_t num_features = 0;
+            std::exception_ptr error;
+            TreeScratch scratch;
+        };
+
+        Executor* const m_executor;
+        const bool m_cover;         // read sum_hessian
+        std::vector<ParsedTree> m_batch;
+        size_t m_trees = 0;         // trees in batch
+        size_t m_batchNodes = 0;    // nodes of trees in batch
+        std::vector<Chunk> m_chunks;
+        TreeScratch m_scratch;
+
+        ModelBuilder m_builder;
+    };
+
+    // QuickScorer engine of predictor: tree leaves are numbered left to right,
+    // false decision node (value >= threshold) clears bits of its yes subtree leaves
+    // in tree leaf bitvector, exit leaf is the first leaf with bit set
+    struct QuickScorer
+    {
+        // bitvector word mask
+        struct Mask
+        {
+            uint32_t word = 0;
+            uint64_t mask = 0;
+        };
+
+        // decision node and leaf range [begin, end) of its yes subtree
+        struct Split
+        {
+            uint32_t node = 0;
+            uint32_t begin = 0;
+            uint32_t end = 0;
+        };
+
+        std::vector<uint32_t> features;         // feature mask ranges, num_features + 1
+        std::vector<float> thresholds;          // node thresholds sorted by feature and threshold
+        std::vector<Mask> masks;                // node masks in threshold order
+        std::vector<uint32_t> missing;          // feature missing mask ranges, num_features + 1
+        std::vector<uint32_t> missing_masks;    // masks of nodes with default direction no
+        std::vector<uint32_t> trees;            // first bitvector word of tree, trees + 1
+        std::vector<uint32_t> tree_leaves;      // first leaf of tree
+        std::vector<float> leaves;              // leaf values
+        uint32_t words = 0;                     // bitvector words of all trees
+    };
+
+    // decision node of quantized tree: yes child follows its parent (yes leaf value is
+    // stored in the next node), no child is inline leaf or node offset
+    struct QuantizedNode
+    {
+        static constexpr uint16_t FEATURE_MASK = (1U << 13) - 1;   // predictor feature index bits of info
+        static constexpr uint16_t YES_LEAF = 1U << 13;
+        static constexpr uint16_t NO_LEAF = 1U << 14;
+        static constexpr uint16_t DEFAULT_LEFT = 1U << 15;
+
+        uint16_t info = 0;          // predictor feature index and flags
+        uint16_t bin = 0;           // yes if value bin < bin (threshold index + 1, 0 for NaN threshold)
+        Node::Child no = {};        // no child, yes leaf value in leaf slot
+    };
+
+    // predictor with thresholds quantized to feature bins
+    // bin of value is the number of feature thresholds <= value, so with sorted distinct
+    // thresholds value < thresholds[j] is bin <= j: decisions are those of float comparison
+    struct Quantized
+    {
+        std::vector<uint32_t> features;         // features used by predictor
+        std::vector<uint32_t> offsets;          // threshold ranges of used features, features + 1
+        std::vector<float> thresholds;          // sorted distinct thresholds of used features
+        std::vector<QuantizedNode> nodes;       // trees in preorder
+        std::vector<uint32_t> roots;            // root node of tree
+        bool wide = false;                      // uint16 bins (uint8 for up to 253 thresholds per feature)
+    };
+
+    // binary model file header, node/tree/predictor/feature sections follow at aligned offsets
+    struct BinaryHeader
+    {
+        char magic[8] = {'X', 'G', 'B', 'P', 'R', 'E', 'D', '\0'};
+        uint32_t version = BINARY_VERSION;
+        uint32_t byte_order = BINARY_BYTE_ORDER;    // written in native byte order
+        uint64_t file_size = 0;
+        uint64_t checksum = 0;                      // of the whole file with zero checksum
+        uint64_t nodes_offset = 0;
+        uint64_t nodes = 0;
+        uint64_t trees_offset = 0;
+        uint64_t trees = 0;
+        uint64_t predictors_offset = 0;
+        uint64_t predictors = 0;
+        uint32_t node_size = sizeof(Node);
+        uint32_t num_features = 0;
+        float base_score = 0.0f;
+        uint32_t transformation = 0;
+        uint64_t features_offset = 0;               // version 2, zero header padding of version 1
+        uint64_t features = 0;
+    };
+
+    static_assert(sizeof(Node) == 16 && std::is_trivially_copyable<Node>::value, "binary model node layout");
+
+    static constexpr uint32_t BINARY_BYTE_ORDER = 0x01020304U;
+    static constexpr uint64_t BINARY_ALIGNMENT = 64;    // section alignment, node arena is cache line aligned
+
+    // UBJSON (draft 12, as written by XGBoost) reader, calls SAX handler like rapidjson::Reader
+    // typed arrays are read in bulk and passed to handler.Values(values, count)
+    class UbjsonReader
+    {
+    public:
+        explicit UbjsonReader(std::istream& stream)
+            :m_stream(stream)
+        {
+            // remaining bytes bound counts of containers
+            m_stream.seekg(0, std::ios::end);
+            m_remaining = m_stream ? static_cast<uint64_t>(m_stream.tellg()) : 0;
+            m_stream.seekg(0);
+        }
+
+        //------------------------------------------------------------------------------
+        // parse single value, false on invalid input or handler error
+        //------------------------------------------------------------------------------
+        template<typename Handler>
+        bool parse(Handler& handler)
+        {
+            char marker = 0;
+            return read(marker) && value(marker, handler);
+        }
+
+    private:
+        //------------------------------------------------------------------------------
+        // read bytes
+        //------------------------------------------------------------------------------
+        bool read(void* data, const uint64_t size)
+        {
+            if (size > m_remaining)
+            {
+                return false;
+            }
+            m_remaining -= size;
+            return static_cast<bool>(m_stream.read(static_cast<char*>(data), size));
+        }
+
+        bool read(char& marker)
+        {
+            // skip no-op markers
+            do
+            {
+                if (!read(&marker, 1))
+                {
+                    return false;
+                }
+            } while (marker == 'N');
+            return true;
+        }
+
+        //------------------------------------------------------------------------------
+        // read big-endian number
+        //------------------------------------------------------------------------------
+        template<typename T>
+        bool read(T& value)
+        {
+            if (!read(&value, sizeof(T)))
+            {
+                return false;
+            }
+            swap(&value, 1);
+            return true;
+        }
+
+        //------------------------------------------------------------------------------
+        // convert big-endian numbers to native byte order
+        //------------------------------------------------------------------------------
+        template<typename T>
+        static void swap(T* values, const size_t count)
+        {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (sizeof(T) == 2)
+                {
+                    uint16_t word;
+                    std::memcpy(&word, values + i, 2);
+                    word = __builtin_bswap16(word);
+                    std::memcpy(values + i, &word, 2);
+                }
+                else if (sizeof(T) == 4)
+                {
+                    uint32_t word;
+                    std::memcpy(&word, values + i, 4);
+                    word = __builtin_bswap32(word);
+                    std::memcpy(values + i, &word, 4);
+                }
+                else if (sizeof(T) == 8)
+                {
+                    uint64_t word;
+                    std::memcpy(&word, values + i, 8);
+                    word = __builtin_bswap64(word);
+                    std::memcpy(values + i, &word, 8);
+                }
+            }
+#else
+            static_cast<void>(values);
+            static_cast<void>(count);
+#endif
+        }
+
+        //------------------------------------------------------------------------------
+        // read integer of marker type (length, count)
+        //------------------------------------------------------------------------------
+        bool integer(const char marker, int64_t& value)
+        {
+            switch (marker)
+            {
+                case 'i':
+                    return integer<int8_t>(value);
+                case 'U':
+                    return integer<uint8_t>(value);
+                case 'I':
+                    return integer<int16_t>(value);
+                case 'l':
+                    return integer<int32_t>(value);
+                case 'L':
+                    return integer<int64_t>(value);
+                default:
+                    return false;
+            }
+        }
+
+        template<typename T>
+        bool integer(int64_t& value)
+        {
+            T result = 0;
+            if (!read(result))
+            {
+                return false;
+            }
+            value = result;
+            return true;
+        }
+
+        //------------------------------------------------------------------------------
+        // read length/count
+        //------------------------------------------------------------------------------
+        bool length(uint64_t& length)
+        {
+            char marker = 0;
+            int64_t value = 0;
+            if (!read(marker) || !integer(marker, value) || value < 0)
+            {
+                return false;
+            }
+            length = value;
+            return true;
+        }
+
+        //------------------------------------------------------------------------------
+        // read string of length
+        //------------------------------------------------------------------------------
+        bool string(std::string& value)
+        {
+            uint64_t size = 0;
+            if (!length(size) || size > m_remaining)
+            {
+                return false;
+            }
+            value.resize(size);
+            return read(&value[0], size);
+        }
+
+        //------------------------------------------------------------------------------
+        // read value of marker type
+        //------------------------------------------------------------------------------
+        template<typename Handler>
+        bool value(const char marker, Handler& handler)
+        {
+            switch (marker)
+            {
+                case 'Z':
+                    return handler.Null();
+                case 'T':
+                case 'F':
+                    return handler.Bool(marker == 'T');
+                case 'i':
+                case 'U':
+                case 'I':
+                case 'l':
+                case 'L':
+                {
+                    int64_t value = 0;
+                    return integer(marker, value) && handler.Int64(value);
+                }
+                case 'd':
+                {
+                    float value = 0.0f;
+                    return read(value) && handler.Double(value);
+                }
+                case 'D':
+                {
+                    double value = 0.0;
+                    return read(value) && handler.Double(value);
+                }
+                case 'C':
+                {
+                    char value = 0;
+                    return read(&value, 1) && handler.String(&value, 1, true);
+                }
+                case 'S':
+                case 'H':
+                {
+                    std::string value;
+                    return string(value) && handler.String(value.data(), value.size(), true);
+                }
+                case '[':
+                    return container(false, handler);
+                case '{':
+                    return container(true, handler);
+                default:
+                    return false;
+            }
+        }
+
+        //------------------------------------------------------------------------------
+        // read array/object, optionally typed ($) and counted (#)
+        //------------------------------------------------------------------------------
+        template<typename Handler>
+        bool container(const bool object, Handler& handler)
+        {
+            if (object ? !handler.StartObject() : !handler.StartArray())
+            {
+                return false;
+            }
+
+            char marker = 0;
+            if (!read(marker))
+            {
+                return false;
+            }
+
+            char type = 0;
+            if (marker == '$')
+            {
+                if (!read(type) || !read(marker) || marker != '#')
+                {
+                    return false;
+                }
+            }
+
+            uint64_t count = 0;
+            const bool counted = marker == '#';
+            if (counted && !length(count))
+            {
+                return false;
+            }
+
+            // marker of first item (key length or value) of container without type/count
+            bool pending = !counted;
+
+            auto next = [this, &marker, &pending]()
+            {
+                if (pending)
+                {
+                    pending = false;
+                    return true;
+                }
+                return read(marker);
+            };
+
+            // typed numeric array in bulk
+            if (!object && type)
+            {
+                switch (type)
+                {
+                    case 'i': return values<int8_t>(count, handler) && handler.EndArray(count);
+                    case 'U': return values<uint8_t>(count, handler) && handler.EndArray(count);
+                    case 'I': return values<int16_t>(count, handler) && handler.EndArray(count);
+                    case 'l': return values<int32_t>(count, handler) && handler.EndArray(count);
+                    case 'L': return values<int64_t>(count, handler) && handler.EndArray(count);
+                    case 'd': return values<float>(count, handler) && handler.EndArray(count);
+                    case 'D': return values<double>(count, handler) && handler.EndArray(count);
+                    default: break;
+                }
+            }
+
+            for (uint64_t i = 0; !counted || i < count; ++i)
+            {
+                if (object)
+                {
+                    // key: length marker, length, bytes (no string marker)
+                    if (!next())
+                    {
+                        return false;
+                    }
+                    if (!counted && marker == '}')
+                    {
+                        count = i;
+                        break;
+                    }
+
+                    int64_t size = 0;
+                    if (!integer(marker, size) || size < 0 || static_cast<uint64_t>(size) > m_remaining)
+                    {
+                        return false;
+                    }
+
+                    std::string key(size, '\0');
+                    if (!read(&key[0], size) || !handler.Key(key.data(), key.size(), true))
+                    {
+                        return false;
+                    }
+                }
+
+                if (type)
+                {
+                    marker = type;
+                }
+                else
+                {
+                    if (!next())
+                    {
+                        return false;
+                    }
+                    if (!object && !counted && marker == ']')
+                    {
+                        count = i;
+                        break;
+                    }
+                }
+
+                if (!value(marker, handler))
+                {
+                    return false;
+                }
+            }
+
+            return object ? handler.EndObject(count) : handler.EndArray(count);
+        }
+
+        //------------------------------------------------------------------------------
+        // read typed array values
+        //------------------------------------------------------------------------------
+        template<typename T, typename Handler>
+        bool values(const uint64_t count, Handler& handler)
+        {
+            if (count > m_remaining / sizeof(T))
+            {
+                return false;
+            }
+
+            m_buffer.resize(count * sizeof(T));
+            if (!read(m_buffer.data(), m_buffer.size()))
+            {
+                return false;
+            }
+
+            T* values = reinterpret_cast<T*>(m_buffer.data());
+            swap(values, count);
+            return handler.Values(static_cast<const T*>(values), count);
+        }
+
+    private:
+        std::istream& m_stream;
+        uint64_t m_remaining = 0;
+        std::vector<char> m_buffer;
+    };
+
+    // profile counters of a thread, written by the thread only (relaxed load and store,
+    // no read-modify-write), read by profile()
+    // sample counts rows since the last traced row (Options::profile_sample), thread only
+    struct ProfileCounters
+    {
+        explicit ProfileCounters(const Model& model)
+            :latency(PROFILE_LATENCY_BUCKETS)
+            ,rows(model.predictors.size())
+            ,tree_nodes(model.trees.size())
+            ,tree_ns(model.trees.size())
+            ,feature_splits(model.num_features)
+            ,feature_missing(model.num_features)
+        {}
+
+        std::vector<std::atomic<uint64_t>> latency;
+        std::vector<std::atomic<uint64_t>> rows;
+        std::vector<std::atomic<uint64_t>> tree_nodes;
+        std::vector<std::atomic<uint64_t>> tree_ns;
+        std::vector<std::atomic<uint64_t>> feature_splits;
+        std::vector<std::atomic<uint64_t>> feature_missing;
+        size_t sample = 0;
+    };
+
+    // profile counters of all threads predicting with a predictor
+    struct ProfileRegistry
+    {
+        const uint64_t id = nextProfileId();
+        std::mutex mutex;                                           // guards threads (registration, snapshot)
+        std::vector<std::shared_ptr<ProfileCounters>> threads;
+    };
+
+    static constexpr size_t PROFILE_LATENCY_BUCKETS = 40;
+
+    // records latency of predict call into profile counters (nullptr: off)
+    class ProfileLatency
+    {
+    public:
+        explicit ProfileLatency(ProfileCounters* counters)
+            :m_counters(counters)
+        {
+            if (m_counters)
+            {
+                m_start = std::chrono::steady_clock::now();
+            }
+        }
+
+        ~ProfileLatency()
+        {
+            if (m_counters)
+            {
+                const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start).count();
+                const size_t bucket = std::min<size_t>(63 - __builtin_clzll(ns | 1), PROFILE_LATENCY_BUCKETS - 1);
+                profileAdd(m_counters->latency[bucket], 1);
+            }
+        }
+
+        ProfileLatency(const ProfileLatency&) = delete;
+        ProfileLatency& operator=(const ProfileLatency&) = delete;
+
+    private:
+        ProfileCounters* const m_counters;
+        std::chrono::steady_clock::time_point m_start;
+    };
+
+    // tree-parallel prediction statistics counters
+    struct TreeParallelCounters
+    {
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> wall_ns{0};
+        std::atomic<uint64_t> work_ns{0};
+        std::atomic<uint64_t> critical_ns{0};
+    };
+
+    // bounds of sums of trees [i, predictor end) in min[i]/max[i] (sums of min/max
+    // tree leaves), slack of predictor bounds float rounding of its prediction
+    struct TreeBounds
+    {
+        std::vector<double> min;
+        std::vector<double> max;
+        std::vector<double> slack;
+    };
+
+    // inverted index of model: trees splitting on feature f are trees[offsets[f], offsets[f + 1]),
+    // in tree table order
+    struct FeatureIndex
+    {
+        std::vector<uint32_t> offsets;      // num_features + 1 offsets
+        std::vector<uint32_t> trees;
+        std::vector<uint32_t> predictors;   // predictor of each tree
+    };
+
+    // tree of fused multiclass traversal: tree table index and its predictor
+    struct FusedTree
+    {
+        uint32_t tree = 0;
+        uint32_t predictor = 0;
+    };
+
+    // batch prediction kernel
+    enum class Simd
+    {
+        NONE,
+        AVX2,
+        AVX512
+    };
+
+    // exponential (output transformations): input range, ln2 split for exact n ln2,
+    // 1.5 * 2^23 rounds to integer, polynomial of exp(r) - 1 - r (Cephes expf)
+    static constexpr float EXP_MIN = -86.9f;
+    static constexpr float EXP_MAX = 88.72283f;
+    static constexpr float EXP_LOG2E = 1.44269504f;
+    static constexpr float EXP_LN2_HI = 0.693359375f;
+    static constexpr float EXP_LN2_LO = -2.12194440e-4f;
+    static constexpr float EXP_SHIFT = 12582912.0f;
+    static constexpr uint32_t EXP_SHIFT_BITS = 0x4B400000;
+    static constexpr float EXP_P[6] = {1.9875691500e-4f, 1.3981999507e-3f, 8.3334519073e-3f, 4.1665795894e-2f, 1.6666665459e-1f, 5.0000001201e-1f};
+
+
+private:
+    //------------------------------------------------------------------------------
+    // create predictor of model
+    //------------------------------------------------------------------------------
+    XGBoostPredictor(Model&& model, const Options& options)
+        :m_options(options)
+        ,m_model(compact(std::move(model), m_options, m_compactionStats))
+        ,m_treeBlocks(treeBlocks(m_model, m_options))
+        ,m_simd(simd(m_model, m_options))
+        ,m_quickScorers(quickScorers(m_model, m_options))
+        ,m_quantized(quantize(m_model, m_options))
+        ,m_treeParallelStats(std::make_shared<TreeParallelCounters>())
+        ,m_hitCounts(m_options.count_hits ? std::make_shared<std::vector<std::atomic<uint64_t>>>(m_model.nodes.size() * 2) : nullptr)
+        ,m_profile(m_options.profile || m_options.profile_sample ? std::make_shared<ProfileRegistry>() : nullptr)
+        ,m_featureIndex(featureIndex(m_model))
+        ,m_treeBounds(treeBounds(m_model))
+        ,m_fusedTrees(fusedTrees(m_model))
+        ,m_fusedBlocks(fusedBlocks(m_model, m_fusedTrees, m_options))
+    {}
+
+    //------------------------------------------------------------------------------
+    // calculate prediction
+    //------------------------------------------------------------------------------
+    float predict(const Data& data, const Predictor& predictor) const
+    {
+        if (m_hitCounts || !m_quickScorers.empty() || !m_quantized.empty())
+        {
+            const auto size = data.size();
+            const auto value = [&data, size](const uint32_t feature, float& value)
+            {
+                if (feature < size && data[feature])
+                {
+                    value = *data[feature];
+                    return true;
+                }
+                return false;
+            };
+            if (m_hitCounts)
+            {
+                return countedScore(predictor, value);
+            }
+            return m_quantized.empty() ? quickScore(predictor, value) : quantizedScore(predictor, value);
+        }
+
+        if (treeParallel(predictor))
+        {
+            return predictParallel(predictor, [this, &data](const Tree& tree)
+            {
+                return predict(data, tree);
+            });
+        }
+
+        float prediction = 0.0f;
+
+        for (uint32_t i = predictor.begin; i < predictor.end; ++i)
+        {
+            prediction += predict(data, m_model.trees[i]);
+        }
+
+        prediction += m_model.base_score;
+
+        return prediction;
+    }
+
+    //------------------------------------------------------------------------------
+    // calculate tree prediction
+    //------------------------------------------------------------------------------
+    float predict(const Data& data, const Tree& tree) const
+    {
+        const auto size = data.size();
+        const Node* nodes = m_model.nodes.data();
+
+        uint32_t index = tree.root;
+
+        while (true)
+        {
+            const Node& node = nodes[index];
+            const uint32_t feature = node.feature();
+
+            const bool yes = feature < size && data[feature] ? *data[feature] < node.value : node.defaultLeft();
+            const Node::Child child = yes ? node.children[0] : node.children[1];
+            const uint32_t leaf = yes ? Node::YES_LEAF : Node::NO_LEAF;
+
+            if (node.info & leaf)
+            {
+                return child.value;
+            }
+
+            index = child.offset;
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // predictor is evaluated tree-parallel
+    //------------------------------------------------------------------------------
+    bool treeParallel(const Predictor& predictor) const
+    {
+        return m_options.executor && m_options.parallel_trees > 0 && predictor.end - predictor.begin >= m_options.parallel_trees;
+    }
+
+    //------------------------------------------------------------------------------
+    // calculate prediction with trees split into fixed chunks evaluated on executor
+    // chunk partial sums are added in chunk order, so the result does not depend
+    // on threads (it may differ from sequential sum in the last bits)
+    //------------------------------------------------------------------------------
+    template<typename PredictTree>
+    float predictParallel(const Predictor& predictor, const PredictTree& predictTree) const
+    {
+        using Clock = std::chrono::steady_clock;
+
+        const size_t trees = predictor.end - predictor.begin;
+        const size_t chunks = std::max<size_t>(std::min(m_options.tree_chunks, trees), 1);
+
+        // per-thread chunk partial sums and times, reused by following calls
+        thread_local std::vector<float> partials;
+        thread_local std::vector<uint64_t> times;
+        partials.assign(chunks, 0.0f);
+        times.assign(chunks, 0);
+
+        // task captures two references, so it fits std::function small buffer (no allocation)
+        struct Split
+        {
+            const Tree* trees;
+            size_t count;
+            size_t chunks;
+            float* partials;
+            uint64_t* times;
+        };
+        const Split split{m_model.trees.data() + predictor.begin, trees, chunks, partials.data(), times.data()};
+
+        const auto start = Clock::now();
+
+        m_options.executor->parallelFor(chunks, [&split, &predictTree](const size_t chunk)
+        {
+            const auto chunkStart = Clock::now();
+
+            const Tree* begin = split.trees + split.count * chunk / split.chunks;
+            const Tree* end = split.trees + split.count * (chunk + 1) / split.chunks;
+
+            float partial = 0.0f;
+            for (const Tree* tree = begin; tree != end; ++tree)
+            {
+                partial += predictTree(*tree);
+            }
+            split.partials[chunk] = partial;
+
+            split.times[chunk] = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - chunkStart).count();
+        });
+
+        float prediction = 0.0f;
+        for (const float partial : partials)
+        {
+            prediction += partial;
+        }
+
+        prediction += m_model.base_score;
+
+        // statistics
+        m_treeParallelStats->calls += 1;
+        m_treeParallelStats->wall_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+        for (const uint64_t time : times)
+        {
+            m_treeParallelStats->work_ns += time;
+        }
+        m_treeParallelStats->critical_ns += *std::max_element(times.begin(), times.end());
+
+        return prediction;
+    }
+
+    //------------------------------------------------------------------------------
+    // sum trees of single predictor in order until the margin bounds decide the cutoff
+    // final margin is within the exact bounds of remaining trees widened by the
+    // rounding slack of float summation
+    //------------------------------------------------------------------------------
+    template<typename PredictTree>
+    BoundedPrediction predictBounded(const float cutoff, const bool exitAbove, const PredictTree& predictTree) const
+    {
+        if (m_model.predictors.size() != 1)
+        {
+            throw std::runtime_error("xgboost predict incompatible model size: " + std::to_string(m_model.predictors.size()));
+        }
+
+        const auto& predictor = m_model.predictors.front();
+        const double slack = m_treeBounds.slack.front();
+
+        BoundedPrediction result;
+        float prediction = 0.0f;
+
+        for (uint32_t i = predictor.begin; i < predictor.end; ++i)
+        {
+            const double margin = static_cast<double>(prediction) + m_model.base_score;
+            result.lower = margin + m_treeBounds.min[i] - slack;
+            result.upper = margin + m_treeBounds.max[i] + slack;
+
+            if (result.upper < cutoff || (exitAbove && result.lower >= cutoff))
+            {
+                result.above = result.lower >= cutoff;
+                result.trees = i - predictor.begin;
+                return result;
+            }
+
+            prediction += predictTree(m_model.trees[i]);
+        }
+
+        prediction += m_model.base_score;
+
+        result.above = prediction >= cutoff;
+        result.lower = prediction;
+        result.upper = prediction;
+        result.trees = predictor.end - predictor.begin;
+        return result;
+    }
+
+    //------------------------------------------------------------------------------
+    // run predictBlock(begin, end) for row blocks of rows [0, rows)
+    // blocks of large batches run in parallel on executor, each row is predicted
+    // the same way regardless of thread, so results do not depend on parallelism
+    //------------------------------------------------------------------------------
+    template<typename PredictBlock>
+    void forEachBlock(const size_t rows, const PredictBlock& predictBlock) const
+    {
+        const size_t block = std::max<size_t>(m_options.row_block, 1);
+        const size_t blocks = (rows + block - 1) / block;
+
+        // task captures two references, so it fits std::function small buffer (no allocation)
+        const size_t bounds[2] = {block, rows};
+        auto run = [&predictBlock, &bounds](const size_t i)
+        {
+            predictBlock(i * bounds[0], std::min(i * bounds[0] + bounds[0], bounds[1]));
+        };
+
+        if (m_options.executor && rows >= m_options.parallel_rows && blocks > 1)
+        {
+            m_options.executor->parallelFor(blocks, run);
+        }
+        else
+        {
+            for (size_t i = 0; i < blocks; ++i)
+            {
+                run(i);
+            }
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // calculate predictions of rows [begin, end)
+    // tree engine: tiles of row block x tree block,
+    // a block of trees stays in cache while a block of rows passes through it
+    // predictTile(rowBegin, rowEnd, treeBegin, treeEnd, scores) adds tile trees to row scores
+    // trees are summed in model order, results are identical to row by row prediction
+    // other engines and hit counting: predictRow(row) returns row prediction
+    //------------------------------------------------------------------------------
+    template<typename PredictTile, typename PredictRow>
+    void predictBatch(const Predictor& predictor, const size_t begin, const size_t end, float* scores, const PredictTile& predictTile, const PredictRow& predictRow) const
+    {
+        if (m_options.engine != Engine::TREE || m_hitCounts)
+        {
+            for (size_t row = begin; row < end; ++row)
+            {
+                scores[row] = predictRow(row);
+            }
+            return;
+        }
+
+        const size_t rowBlock = std::max<size_t>(m_options.row_block, 1);
+
+        const auto first = std::upper_bound(m_treeBlocks.begin(), m_treeBlocks.end(), predictor.begin) - 1;
+        const auto last = std::lower_bound(m_treeBlocks.begin(), m_treeBlocks.end(), predictor.end);
+
+        for (size_t rowBegin = begin; rowBegin < end; rowBegin += rowBlock)
+        {
+            const size_t rowEnd = std::min(rowBegin + rowBlock, end);
+
+            std::fill(scores + rowBegin, scores + rowEnd, 0.0f);
+
+            for (auto block = first; block != last; ++block)
+            {
+                predictTile(rowBegin, rowEnd, m_model.trees.data() + *block, m_model.trees.data() + *(block + 1), scores);
+            }
+
+            for (size_t row = rowBegin; row < rowEnd; ++row)
+            {
+                scores[row] += m_model.base_score;
+            }
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // calculate predictions of all predictors of rows [begin, end) into row-major matrix
+    // tree engine: trees of all predictors are interleaved in model (tree_info) order,
+    // so a row block passes once through blocks of trees serving every class,
+    // trees of a predictor are summed in model order, results are identical to row by row prediction
+    // predictTile(rowBegin, rowEnd, tree, scores) adds tree to scores[0, rowEnd - rowBegin)
+    // other engines and hit counting: predictRow(row, predictor) returns row prediction
+    //------------------------------------------------------------------------------
+    template<typename PredictTile, typename PredictRow>
+    void predictFused(const size_t begin, const size_t end, float* scores, const PredictTile& predictTile, const PredictRow& predictRow) const
+    {
+        const size_t classes = m_model.predictors.size();
+
+        if (m_options.engine != Engine::TREE || m_hitCounts)
+        {
+            for (size_t row = begin; row < end; ++row)
+            {
+                for (size_t i = 0; i < classes; ++i)
+                {
+                    scores[row * classes + i] = predictRow(row, m_model.predictors[i]);
+                }
+            }
+            return;
+        }
+
+        const size_t rowBlock = std::max<size_t>(m_options.row_block, 1);
+
+        // per-thread class-major scores of a row block
+        thread_local std::vector<float> scratch;
+        scratch.resize(rowBlock * classes);
+
+        for (size_t rowBegin = begin; rowBegin < end; rowBegin += rowBlock)
+        {
+            const size_t rowEnd = std::min(rowBegin + rowBlock, end);
+
+            std::fill(scratch.begin(), scratch.end(), 0.0f);
+
+            for (size_t block = 0; block + 1 < m_fusedBlocks.size(); ++block)
+            {
+                for (uint32_t i = m_fusedBlocks[block]; i < m_fusedBlocks[block + 1]; ++i)
+                {
+                    const auto& fused = m_fusedTrees[i];
+                    predictTile(rowBegin, rowEnd, &m_model.trees[fused.tree], scratch.data() + fused.predictor * rowBlock);
+                }
+            }
+
+            for (size_t row = rowBegin; row < rowEnd; ++row)
+            {
+                for (size_t i = 0; i < classes; ++i)
+                {
+                    scores[row * classes + i] = scratch[i * rowBlock + row - rowBegin] + m_model.base_score;
+                }
+            }
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // add trees [treeBegin, treeEnd) to scores of rows [begin, end), one row at a time
+    //------------------------------------------------------------------------------
+    template<typename PredictTree>
+    static void predictTile(const size_t begin, const size_t end, const Tree* treeBegin, const Tree* treeEnd, float* scores, const PredictTree& predictTree)
+    {
+        for (size_t row = begin; row < end; ++row)
+        {
+            float prediction = scores[row];
+
+            for (const Tree* tree = treeBegin; tree != treeEnd; ++tree)
+            {
+                prediction += predictTree(row, *tree);
+            }
+
+            scores[row] = prediction;
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // add trees [treeBegin, treeEnd) to scores of dense rows [begin, end)
+    // groups of 16/8 rows go through AVX-512/AVX2 kernel, remaining rows are scalar
+    //------------------------------------------------------------------------------
+    template<bool Checked>
+    void predictTile(const size_t begin, const size_t end, const Tree* treeBegin, const Tree* treeEnd, const float* rows, const size_t columns, float* scores) const
+    {
+        size_t row = begin;
+
+#ifdef XGBOOST_PREDICTOR_SIMD
+        // kernels address row values with 32-bit gather indices
+        if (!Checked && columns <= std::numeric_limits<int>::max() / 16)
+        {
+            if (m_simd == Simd::AVX512)
+            {
+                for (; row + 16 <= end; row += 16)
+                {
+                    predictAVX512(m_model.nodes.data(), treeBegin, treeEnd, rows + row * columns, columns, scores + row);
+                }
+            }
+            else if (m_simd == Simd::AVX2)
+            {
+                for (; row + 8 <= end; row += 8)
+                {
+                    predictAVX2(m_model.nodes.data(), treeBegin, treeEnd, rows + row * columns, columns, scores + row);
+                }
+            }
+        }
+#endif
+
+        predictTile(row, end, treeBegin, treeEnd, scores, [this, rows, columns](const size_t row, const Tree& tree)
+        {
+            return predict<Checked>(rows + row * columns, columns, tree);
+        });
+    }
+
+#ifdef XGBOOST_PREDICTOR_SIMD
+    //------------------------------------------------------------------------------
+    // add trees to scores of 8 dense rows, rows advance through a tree in lockstep
+    // same decisions as scalar traversal: (value < threshold) | (isnan(value) & default_left)
+    //------------------------------------------------------------------------------
+    __attribute__((target("avx2")))
+    static void predictAVX2(const Node* nodes, const Tree* treeBegin, const Tree* treeEnd, const float* rows, const size_t columns, float* scores)
+    {
+        // node fields as 32-bit words: value, info, yes, no
+        const int* base = reinterpret_cast<const int*>(nodes);
+
+        const __m256i rowOffsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(columns));
+        const __m256i featureMask = _mm256_set1_epi32(Node::FEATURE_MASK);
+        const __m256i yesLeaf = _mm256_set1_epi32(Node::YES_LEAF);
+        const __m256i noLeaf = _mm256_set1_epi32(Node::NO_LEAF);
+        const __m256i one = _mm256_set1_epi32(1);
+        const __m256i three = _mm256_set1_epi32(3);
+
+        __m256 prediction = _mm256_loadu_ps(scores);
+
+        for (const Tree* tree = treeBegin; tree != treeEnd; ++tree)
+        {
+            __m256i index = _mm256_set1_epi32(tree->root * 4);
+            __m256i active = _mm256_set1_epi32(-1);
+            __m256 result = _mm256_setzero_ps();
+
+            while (true)
+            {
+                const __m256 threshold = _mm256_i32gather_ps(reinterpret_cast<const float*>(base), index, 4);
+                const __m256i info = _mm256_i32gather_epi32(base, _mm256_add_epi32(index, one), 4);
+                const __m256i feature = _mm256_and_si256(info, featureMask);
+                const __m256 value = _mm256_i32gather_ps(rows, _mm256_add_epi32(rowOffsets, feature), 4);
+
+                const __m256i defaultLeft = _mm256_srai_epi32(info, 31);
+                const __m256i less = _mm256_castps_si256(_mm256_cmp_ps(value, threshold, _CMP_LT_OQ));
+                const __m256i missing = _mm256_castps_si256(_mm256_cmp_ps(value, value, _CMP_UNORD_Q));
+                const __m256i yes = _mm256_or_si256(less, _mm256_and_si256(missing, defaultLeft));
+
+                // yes child word index + 2, no child word index + 3
+                const __m256i child = _mm256_i32gather_epi32(base, _mm256_add_epi32(_mm256_add_epi32(index, three), yes), 4);
+                const __m256i leafFlag = _mm256_blendv_epi8(noLeaf, yesLeaf, yes);
+                const __m256i leaf = _mm256_cmpeq_epi32(_mm256_and_si256(info, leafFlag), leafFlag);
+
+                result = _mm256_blendv_ps(result, _mm256_castsi256_ps(child), _mm256_castsi256_ps(_mm256_and_si256(leaf, active)));
+                active = _mm256_andnot_si256(leaf, active);
+
+                if (_mm256_testz_si256(active, active))
+                {
+                    break;
+                }
+
+                index = _mm256_blendv_epi8(index, _mm256_slli_epi32(child, 2), active);
+            }
+
+            prediction = _mm256_add_ps(prediction, result);
+        }
+
+        _mm256_storeu_ps(scores, prediction);
+    }
+
+    //------------------------------------------------------------------------------
+    // add trees to scores of 16 dense rows, rows advance through a tree in lockstep
+    //------------------------------------------------------------------------------
+    __attribute__((target("avx512f")))
+    static void predictAVX512(const Node* nodes, const Tree* treeBegin, const Tree* treeEnd, const float* rows, const size_t columns, float* scores)
+    {
+        // node fields as 32-bit words: value, info, yes, no
+        const int* base = reinterpret_cast<const int*>(nodes);
+
+        const __m512i rowOffsets = _mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15), _mm512_set1_epi32(columns));
+        const __m512i featureMask = _mm512_set1_epi32(Node::FEATURE_MASK);
+        const __m512i defaultLeft = _mm512_set1_epi32(Node::DEFAULT_LEFT);
+        const __m512i yesLeaf = _mm512_set1_epi32(Node::YES_LEAF);
+        const __m512i noLeaf = _mm512_set1_epi32(Node::NO_LEAF);
+        const __m512i one = _mm512_set1_epi32(1);
+        const __m512i two = _mm512_set1_epi32(2);
+        const __m512i three = _mm512_set1_epi32(3);
+        // sources of gathers: masked forms with all lanes set, unmasked gathers
+        // warn -Wmaybe-uninitialized at -O2 on GCC
+        const __m512 zero = _mm512_setzero_ps();
+        const __m512i zeroWords = _mm512_setzero_si512();
+
+        __m512 prediction = _mm512_loadu_ps(scores);
+
+        for (const Tree* tree = treeBegin; tree != treeEnd; ++tree)
+        {
+            __m512i index = _mm512_set1_epi32(tree->root * 4);
+            __mmask16 active = 0xffff;
+            __m512 result = _mm512_setzero_ps();
+
+            while (true)
+            {
+                const __m512 threshold = _mm512_mask_i32gather_ps(zero, 0xffff, index, base, 4);
+                const __m512i info = _mm512_mask_i32gather_epi32(zeroWords, 0xffff, _mm512_add_epi32(index, one), base, 4);
+                const __m512i feature = _mm512_and_si512(info, featureMask);
+                const __m512 value = _mm512_mask_i32gather_ps(zero, 0xffff, _mm512_add_epi32(rowOffsets, feature), rows, 4);
+
+                const __mmask16 less = _mm512_cmp_ps_mask(value, threshold, _CMP_LT_OQ);
+                const __mmask16 missing = _mm512_cmp_ps_mask(value, value, _CMP_UNORD_Q);
+                const __mmask16 yes = less | (missing & _mm512_test_epi32_mask(info, defaultLeft));
+
+                // yes child word index + 2, no child word index + 3
+                const __m512i child = _mm512_mask_i32gather_epi32(zeroWords, 0xffff, _mm512_mask_add_epi32(_mm512_add_epi32(index, three), yes, index, two), base, 4);
+                const __mmask16 leaf = _mm512_test_epi32_mask(info, _mm512_mask_blend_epi32(yes, noLeaf, yesLeaf));
+
+                result = _mm512_mask_mov_ps(result, leaf & active, _mm512_castsi512_ps(child));
+                active &= ~leaf;
+
+                if (!active)
+                {
+                    break;
+                }
+
+                index = _mm512_mask_slli_epi32(index, active, child, 2);
+            }
+
+            prediction = _mm512_add_ps(prediction, result);
+        }
+
+        _mm512_storeu_ps(scores, prediction);
+    }
+#endif
+
+    //------------------------------------------------------------------------------
+    // output margin transformation of predictions of predict() and std::vector
+    // overloads: expf, softmax of each row of columns predictions sums in double
+    // single row predictions[0, size) when columns = size
+    //------------------------------------------------------------------------------
+    static void transformOutput(float* predictions, const size_t size, const size_t columns, const Transformation transformation)
+    {
+        if (transformation == Transformation::SIGMOID)
+        {
+            for (size_t i = 0; i < size; ++i)
+            {
+                predictions[i] = 1.0f / (1.0f + expf(-predictions[i]));
+            }
+        }
+        else if (transformation == Transformation::SOFTMAX && columns > 0)
+        {
+            for (float* row = predictions; row + columns <= predictions + size; row += columns)
+            {
+                float max = std::numeric_limits<float>::min();
+                for (size_t i = 0; i < columns; ++i)
+                {
+                    max = std::max(max, row[i]);
+                }
+                double sum = 0.0;
+                for (size_t i = 0; i < columns; ++i)
+                {
+                    row[i] = expf(row[i] - max);
+                    sum += row[i];
+                }
+                for (size_t i = 0; i < columns; ++i)
+                {
+                    row[i] /= sum;
+                }
+            }
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // exp(x) (Sigmoid: 1 / (1 + exp(-x))) of values in place
+    // groups of 8 values go through AVX2 kernel when the CPU supports it,
+    // it computes the same operations as the scalar code, so results do not depend on it
+    //------------------------------------------------------------------------------
+    template<bool Sigmoid>
+    static void exponential(float* values, const size_t size)
+    {
+        size_t i = 0;
+
+#ifdef XGBOOST_PREDICTOR_SIMD
+        static const bool avx2 = __builtin_cpu_supports("avx2");
+        if (avx2)
+        {
+            for (; i + 8 <= size; i += 8)
+            {
+                exponentialAVX2<Sigmoid>(values + i);
+            }
+        }
+#endif
+
+        for (; i < size; ++i)
+        {
+            values[i] = Sigmoid ? 1.0f / (1.0f + exponential(-values[i])) : exponential(values[i]);
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // exp(x) within 1 ulp of expf, branch-free: x = n ln2 + r, exp(x) = 2^n exp(r)
+    // (Cephes expf polynomial), results below exp(EXP_MIN) (~2^-125) flush to 0, above FLT_MAX are inf
+    //------------------------------------------------------------------------------
+    static float exponential(const float value)
+    {
+        float x = value < EXP_MIN ? EXP_MIN : value;
+        x = x > EXP_MAX ? EXP_MAX : x;
+
+        // n = round(x / ln2) in low mantissa bits of shifted value
+        const float shifted = x * EXP_LOG2E + EXP_SHIFT;
+        const float n = shifted - EXP_SHIFT;
+        const float r = (x - n * EXP_LN2_HI) - n * EXP_LN2_LO;
+
+        float y = EXP_P[0];
+        for (size_t i = 1; i < 6; ++i)
+        {
+            y = y * r + EXP_P[i];
+        }
+        y = y * r * r + r + 1.0f;
+
+        uint32_t bits;
+        std::memcpy(&bits, &shifted, sizeof(bits));
+        bits = (bits - EXP_SHIFT_BITS + 126) << 23;
+
+        // 2^n = 2^(n - 1) * 2, n up to 128
+        float scale;
+        std::memcpy(&scale, &bits, sizeof(scale));
+
+        y = y * scale * 2.0f;
+        y = value < EXP_MIN ? 0.0f : y;
+        y = value > EXP_MAX ? std::numeric_limits<float>::infinity() : y;
+
+        return y;
+    }
+
+#ifdef XGBOOST_PREDICTOR_SIMD
+    //------------------------------------------------------------------------------
+    // exp(x) (Sigmoid: 1 / (1 + exp(-x))) of 8 values in place, see scalar exponential
+    // max/min operand order keeps NaN like the scalar comparisons
+    //------------------------------------------------------------------------------
+    template<bool Sigmoid>
+    __attribute__((target("avx2")))
+    static void exponentialAVX2(float* values)
+    {
+        __m256 value = _mm256_loadu_ps(values);
+        if (Sigmoid)
+        {
+            value = _mm256_sub_ps(_mm256_setzero_ps(), value);
+        }
+
+        const __m256 min = _mm256_set1_ps(EXP_MIN);
+        const __m256 max = _mm256_set1_ps(EXP_MAX);
+        __m256 x = _mm256_max_ps(min, value);
+        x = _mm256_min_ps(max, x);
+
+        const __m256 shift = _mm256_set1_ps(EXP_SHIFT);
+        const __m256 shifted = _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(EXP_LOG2E)), shift);
+        const __m256 n = _mm256_sub_ps(shifted, shift);
+        const __m256 r = _mm256_sub_ps(_mm256_sub_ps(x, _mm256_mul_ps(n, _mm256_set1_ps(EXP_LN2_HI))), _mm256_mul_ps(n, _mm256_set1_ps(EXP_LN2_LO)));
+
+        __m256 y = _mm256_set1_ps(EXP_P[0]);
+        for (size_t i = 1; i < 6; ++i)
+        {
+            y = _mm256_add_ps(_mm256_mul_ps(y, r), _mm256_set1_ps(EXP_P[i]));
+        }
+        y = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(y, r), r), r), _mm256_set1_ps(1.0f));
+
+        const __m256i bits = _mm256_slli_epi32(_mm256_add_epi32(_mm256_sub_epi32(_mm256_castps_si256(shifted), _mm256_set1_epi32(EXP_SHIFT_BITS)), _mm256_set1_epi32(126)), 23);
+        y = _mm256_mul_ps(_mm256_mul_ps(y, _mm256_castsi256_ps(bits)), _mm256_set1_ps(2.0f));
+        y = _mm256_andnot_ps(_mm256_cmp_ps(value, min, _CMP_LT_OQ), y);
+        y = _mm256_blendv_ps(y, _mm256_set1_ps(std::numeric_limits<float>::infinity()), _mm256_cmp_ps(value, max, _CMP_GT_OQ));
+
+        if (Sigmoid)
+        {
+            const __m256 one = _mm256_set1_ps(1.0f);
+            y = _mm256_div_ps(one, _mm256_add_ps(one, y));
+        }
+
+        _mm256_storeu_ps(values, y);
+    }
+#endif
+
+    //------------------------------------------------------------------------------
+    // check caller output buffer size
+    //------------------------------------------------------------------------------
+    static void checkOutput(const size_t size, const size_t required)
+    {
+        if (size < required)
+        {
+            throw std::runtime_error("xgboost predict output too small: " + std::to_string(size) + " < " + std::to_string(required));
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // check matrix of size predictions has whole rows of columns predictions
+    //------------------------------------------------------------------------------
+    static void checkColumns(const size_t size, const size_t columns)
+    {
+        if (columns > 0 && size % columns != 0)
+        {
+            throw std::runtime_error("xgboost transform partial row: " + std::to_string(size) + " % " + std::to_string(columns) + " != 0");
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // calculate prediction from dense data
+    //------------------------------------------------------------------------------
+    template<bool Checked>
+    float predict(const float* data, const size_t size, const Predictor& predictor) const
+    {
+        if (m_hitCounts || !m_quickScorers.empty() || !m_quantized.empty())
+        {
+            const auto value = [data, size](const uint32_t feature, float& value)
+            {
+                value = !Checked || feature < size ? data[feature] : std::numeric_limits<float>::quiet_NaN();
+                return !std::isnan(value);
+            };
+            if (m_hitCounts)
+            {
+                return countedScore(predictor, value);
+            }
+            return m_quantized.empty() ? quickScore(predictor, value) : quantizedScore(predictor, value);
+        }
+
+        if (treeParallel(predictor))
+        {
+            return predictParallel(predictor, [this, data, size](const Tree& tree)
+            {
+                return predict<Checked>(data, size, tree);
+            });
+        }
+
+        float prediction = 0.0f;
+
+        for (uint32_t i = predictor.begin; i < predictor.end; ++i)
+        {
+            prediction += predict<Checked>(data, size, m_model.trees[i]);
+        }
+
+        prediction += m_model.base_score;
+
+        return prediction;
+    }
+
+    //------------------------------------------------------------------------------
+    // calculate tree prediction from dense data
+    // unchecked variant requires size >= m_model.num_features
+    //------------------------------------------------------------------------------
+    template<bool Checked>
+    float predict(const float* data, const size_t size, const Tree& tree) const
+    {
+        const Node* nodes = m_model.nodes.data();
+
+        uint32_t index = tree.root;
+
+        while (true)
+        {
+            const Node& node = nodes[index];
+            const uint32_t feature = node.feature();
+
+            float value;
+            if constexpr (Checked)
+            {
+                value = feature < size ? data[feature] : std::numeric_limits<float>::quiet_NaN();
+            }
+            else
+            {
+                value = data[feature];
+            }
+
+            // NaN compares false, missing value follows default direction
+            const bool yes = (value < node.value) | (std::isnan(value) & node.defaultLeft());
+            const Node::Child child = yes ? node.children[0] : node.children[1];
+            const uint32_t leaf = yes ? Node::YES_LEAF : Node::NO_LEAF;
+
+            if (node.info & leaf)
+            {
+                return child.value;
+            }
+
+            index = child.offset;
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // calculate prediction by tree traversal counting taken branches of nodes
+    // value(feature, value) returns false for missing feature
+    //------------------------------------------------------------------------------
+    template<typename Value>
+    float countedScore(const Predictor& predictor, const Value& value) const
+    {
+        const Node* nodes = m_model.nodes.data();
+        auto& hits = *m_hitCounts;
+
+        float prediction = 0.0f;
+
+        for (uint32_t i = predictor.begin; i < predictor.end; ++i)
+        {
+            uint32_t index = m_model.trees[i].root;
+
+            while (true)
+            {
+                const Node& node = nodes[index];
+
+                // NaN compares false, missing value follows default direction
+                float x;
+                const bool yes = value(node.feature(), x) ? x < node.value : node.defaultLeft();
+                hits[index * 2 + !yes].fetch_add(1, std::memory_order_relaxed);
+
+                const Node::Child child = yes ? node.children[0] : node.children[1];
+                if (node.info & (yes ? Node::YES_LEAF : Node::NO_LEAF))
+                {
+                    prediction += child.value;
+                    break;
+                }
+
+                index = child.offset;
+            }
+        }
+
+        prediction += m_model.base_score;
+
+        return prediction;
+    }
+
+    //------------------------------------------------------------------------------
+    // profile counters of calling thread recording predict call latency, nullptr:
+    // latency is not profiled (Options::profile)
+    //------------------------------------------------------------------------------
+    ProfileCounters* latencyCounters() const
+    {
+        return m_options.profile ? &profileCounters() : nullptr;
+    }
+
+    //------------------------------------------------------------------------------
+    // trace every profile_sample-th row of the calling thread by tree traversal of all
+    // predictors (Options::profile_sample), traces only record the profile, predictions
+    // are made by the configured engine
+    // called before the predict call is timed, so traces do not count as latency
+    // value(row, feature, value) returns false for missing feature of row
+    //------------------------------------------------------------------------------
+    template<typename Value>
+    void profileRows(const size_t rows, const Value& value) const
+    {
+        if (m_options.profile_sample == 0)
+        {
+            return;
+        }
+
+        auto& counters = profileCounters();
+
+        for (size_t row = 0; row < rows; ++row)
+        {
+            if (++counters.sample < m_options.profile_sample)
+            {
+                continue;
+            }
+            counters.sample = 0;
+
+            const auto rowValue = [&value, row](const uint32_t feature, float& x)
+            {
+                return value(row, feature, x);
+            };
+            for (const auto& predictor : m_model.predictors)
+            {
+                profileAdd(counters.rows[&predictor - m_model.predictors.data()], 1);
+                for (uint32_t i = predictor.begin; i < predictor.end; ++i)
+                {
+                    profiledTree(m_model.trees[i], rowValue, counters);
+                }
+            }
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // value of feature of row, false for missing feature
+    //------------------------------------------------------------------------------
+    static bool featureValue(const Data& data, const uint32_t feature, float& value)
+    {
+        if (feature < data.size() && data[feature])
+        {
+            value = *data[feature];
+            return true;
+        }
+        return false;
+    }
+
+    //------------------------------------------------------------------------------
+    // value of feature of dense row of size values, false for missing feature (NaN)
+    //------------------------------------------------------------------------------
+    static bool featureValue(const float* data, const size_t size, const uint32_t feature, float& value)
+    {
+        value = feature < size ? data[feature] : std::numeric_limits<float>::quiet_NaN();
+        return !std::isnan(value);
+    }
+
+    //------------------------------------------------------------------------------
+    // calculate tree prediction recording visited nodes, missing values and time
+    //------------------------------------------------------------------------------
+    template<typename Value>
+    float profiledTree(const Tree& tree, const Value& value, ProfileCounters& counters) const
+    {
+        const auto start = std::chrono::steady_clock::now();
+        const Node* nodes = m_model.nodes.data();
+
+        uint32_t index = tree.root;
+        uint64_t visited = 0;
+        float result;
+
+        while (true)
+        {
+            const Node& node = nodes[index];
+            const uint32_t feature = node.feature();
+            ++visited;
+
+            // NaN compares false, missing value follows default direction
+            float x;
+            const bool present = value(feature, x);
+            profileAdd(counters.feature_splits[feature], 1);
+            profileAdd(counters.feature_missing[feature], !present);
+
+            const bool yes = present ? x < node.value : node.defaultLeft();
+            const Node::Child child = yes ? node.children[0] : node.children[1];
+            if (node.info & (yes ? Node::YES_LEAF : Node::NO_LEAF))
+            {
+                result = child.value;
+                break;
+            }
+
+            index = child.offset;
+        }
+
+        const size_t i = &tree - m_model.trees.data();
+        profileAdd(counters.tree_nodes[i], visited);
+        profileAdd(counters.tree_ns[i], std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+
+        return result;
+    }
+
+    //------------------------------------------------------------------------------
+    // profile counters of calling thread, registered on first use
+    // entries of released predictors are dropped when a thread registers
+    //------------------------------------------------------------------------------
+    ProfileCounters& profileCounters() const
+    {
+        struct Entry
+        {
+            uint64_t id;
+            std::weak_ptr<ProfileRegistry> registry;
+            std::shared_ptr<ProfileCounters> counters;
+        };
+        thread_local std::vector<Entry> cache;
+
+        for (const auto& entry : cache)
+        {
+            if (entry.id == m_profile->id)
+            {
+                return *entry.counters;
+            }
+        }
+
+        cache.erase(std::remove_if(cache.begin(), cache.end(), [](const Entry& entry)
+        {
+            return entry.registry.expired();
+        }), cache.end());
+
+        auto counters = std::make_shared<ProfileCounters>(m_model);
+        {
+            const std::lock_guard<std::mutex> lock(m_profile->mutex);
+            m_profile->threads.push_back(counters);
+        }
+        cache.push_back(Entry{m_profile->id, m_profile, counters});
+
+        return *counters;
+    }
+
+    //------------------------------------------------------------------------------
+    // add to profile counter of calling thread
+    //------------------------------------------------------------------------------
+    static void profileAdd(std::atomic<uint64_t>& counter, const uint64_t value)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    //------------------------------------------------------------------------------
+    // unique profile id, profiles at the same address do not share thread counters
+    //------------------------------------------------------------------------------
+    static uint64_t nextProfileId()
+    {
+        static std::atomic<uint64_t> id{0};
+        return ++id;
+    }
+
+    //------------------------------------------------------------------------------
+    // calculate prediction with QuickScorer engine
+    // value(feature, value) returns false for missing feature
+    //------------------------------------------------------------------------------
+    template<typename Value>
+    float quickScore(const Predictor& predictor, const Value& value) const
+    {
+        const auto& scorer = m_quickScorers[&predictor - m_model.predictors.data()];
+
+        // per-thread tree leaf bitvectors
+        thread_local std::vector<uint64_t> bitvectors;
+        bitvectors.assign(scorer.words, ~0ULL);
+        uint64_t* words = bitvectors.data();
+
+        // clear leaves of false nodes feature by feature
+        const uint32_t features = scorer.features.size() - 1;
+
+        for (uint32_t feature = 0; feature < features; ++feature)
+        {
+            uint32_t begin = scorer.features[feature];
+            const uint32_t end = scorer.features[feature + 1];
+
+            if (begin == end)
+            {
+                continue;
+            }
+
+            float x;
+            if (!value(feature, x))
+            {
+                // missing value follows default direction
+                for (uint32_t i = scorer.missing[feature]; i < scorer.missing[feature + 1]; ++i)
+                {
+                    const auto& mask = scorer.masks[scorer.missing_masks[i]];
+                    words[mask.word] &= mask.mask;
+                }
+            }
+            else if (std::isnan(x))
+            {
+                // NaN value compares false, all nodes are false
+                for (; begin < end; ++begin)
+                {
+                    words[scorer.masks[begin].word] &= scorer.masks[begin].mask;
+                }
+            }
+            else
+            {
+                // node is false when threshold <= value, thresholds are sorted
+                for (; begin < end && scorer.thresholds[begin] <= x; ++begin)
+                {
+                    words[scorer.masks[begin].word] &= scorer.masks[begin].mask;
+                }
+            }
+        }
+
+        // exit leaf is the first leaf with bit set
+        float prediction = 0.0f;
+
+        for (uint32_t tree = 0; tree + 1 < scorer.trees.size(); ++tree)
+        {
+            uint32_t word = scorer.trees[tree];
+            while (!words[word])
+            {
+                ++word;
+            }
+
+            const uint32_t leaf = (word - scorer.trees[tree]) * 64 + __builtin_ctzll(words[word]);
+            prediction += scorer.leaves[scorer.tree_leaves[tree] + leaf];
+        }
+
+        prediction += m_model.base_score;
+
+        return prediction;
+    }
+
+    //------------------------------------------------------------------------------
+    // calculate prediction with quantized engine
+    // value(feature, value) returns false for missing feature
+    //------------------------------------------------------------------------------
+    template<typename Value>
+    float quantizedScore(const Predictor& predictor, const Value& value) const
+    {
+        const auto& quantized = m_quantized[&predictor - m_model.predictors.data()];
+        return quantized.wide ? quantizedScore<uint16_t>(quantized, value) : quantizedScore<uint8_t>(quantized, value);
+    }
+
+    //------------------------------------------------------------------------------
+    // bin row features used by predictor, then walk quantized trees
+    // missing feature has the max bin (default direction), NaN value the one below it
+    // (compares false), both are above any node bin
+    //------------------------------------------------------------------------------
+    template<typename Bin, typename Value>
+    float quantizedScore(const Quantized& quantized, const Value& value) const
+    {
+        constexpr uint32_t MISSING = std::numeric_limits<Bin>::max();
+        constexpr uint32_t NOT_A_NUMBER = MISSING - 1;
+
+        // per-thread row bins
+        thread_local std::vector<Bin> bins;
+        bins.resize(quantized.features.size());
+
+        for (size_t i = 0; i < quantized.features.size(); ++i)
+        {
+            float x;
+            if (!value(quantized.features[i], x))
+            {
+                bins[i] = MISSING;
+            }
+            else if (std::isnan(x))
+            {
+                bins[i] = NOT_A_NUMBER;
+            }
+            else
+            {
+                // branch-free binary search: base is last threshold <= x (or first)
+                const float* begin = quantized.thresholds.data() + quantized.offsets[i];
+                const float* base = begin;
+                size_t count = quantized.offsets[i + 1] - quantized.offsets[i];
+                if (count == 0)
+                {
+                    bins[i] = 0;
+                    continue;
+                }
+                while (count > 1)
+                {
+                    const size_t half = count / 2;
+                    base = x < base[half] ? base : base + half;
+                    count -= half;
+                }
+                bins[i] = (base - begin) + !(x < *base);
+            }
+        }
+
+        float prediction = 0.0f;
+
+        for (const uint32_t root : quantized.roots)
+        {
+            const QuantizedNode* nodes = quantized.nodes.data();
+            uint32_t index = root;
+
+            while (true)
+            {
+                const QuantizedNode& node = nodes[index];
+                const uint32_t bin = bins[node.info & QuantizedNode::FEATURE_MASK];
+
+                const bool yes = (bin < node.bin) | ((bin == MISSING) & ((node.info & QuantizedNode::DEFAULT_LEFT) != 0));
+                if (yes)
+                {
+                    if (node.info & QuantizedNode::YES_LEAF)
+                    {
+                        prediction += nodes[index + 1].no.value;
+                        break;
+                    }
+                    ++index;
+                }
+                else
+                {
+                    if (node.info & QuantizedNode::NO_LEAF)
+                    {
+                        prediction += node.no.value;
+                        break;
+                    }
+                    index = node.no.offset;
+                }
+            }
+        }
+
+        prediction += m_model.base_score;
+
+        return prediction;
+    }
+
+    //------------------------------------------------------------------------------
+    // parse JSON model file with streaming (SAX) reader
+    // trees are packed into the node arena as they are read, memory stays bounded by
+    // the model size and one tree, no DOM is built
+    //------------------------------------------------------------------------------
+    static Model parse(const std::string& jsonFile, const Options& options)
+    {
+        // stream wrapper
+        std::ifstream stream(jsonFile);
+        rapidjson::IStreamWrapper wrapper(stream);
+
+        // parse JSON model
+        JsonHandler handler(options.executor.get(), options.layout == Layout::COVER);
+        rapidjson::Reader reader;
+        if (reader.Parse(wrapper, handler).IsError())
+        {
+            throw std::runtime_error(handler.error.empty() ? "invalid xgboost json model" : handler.error);
+        }
+
+        return build(handler.finish());
+    }
+
+    //------------------------------------------------------------------------------
+    // parse UBJSON model file (XGBoost .ubj), same schema as JSON model
+    //------------------------------------------------------------------------------
+    static Model parseUbjson(const std::string& ubjsonFile, const Options& options)
+    {
+        std::ifstream stream(ubjsonFile, std::ios::binary);
+
+        JsonHandler handler(options.executor.get(), options.layout == Layout::COVER);
+        UbjsonReader reader(stream);
+        if (!reader.parse(handler))
+        {
+            throw std::runtime_error(handler.error.empty() ? "invalid xgboost ubjson model" : handler.error);
+        }
+
+        return build(handler.finish());
+    }
+
+    //------------------------------------------------------------------------------
+    // build model from trees packed in model file order
+    //------------------------------------------------------------------------------
+    static Model build(ModelBuilder&& builder)
+    {
+        // get tree_info for multiclass predictors
+        const auto& tree_info = builder.tree_info;
+        if (tree_info.size() != builder.trees.size())
+        {
+            throw std::runtime_error("unexprected tree_info size: " + std::to_string(tree_info.size()) +
+                    ", trees: " + std::to_string(builder.trees.size()));
+        }
+
+        // group trees by predictor
+        std::vector<std::vector<size_t>> groups;
+
+        for (size_t i = 0; i < tree_info.size(); ++i)
+        {
+            const int group = tree_info[i];
+            if (group < 0)
+            {
+                throw std::runtime_error("unexpected tree_info group: " + std::to_string(group));
+            }
+
+            groups.resize(groups.size() < group + 1U ? group + 1U : groups.size());
+
+            groups[group].push_back(i);
+        }
+
+        // trees grouped by predictor (multiclass) are moved into a new node arena,
+        // child offsets are relocated
+        Model result;
+        result.num_features = builder.num_features;
+
+        std::vector<Tree> trees;
+        std::vector<Predictor> predictors;
+
+        // trees in model file order may be grouped already (e.g. single predictor)
+        bool grouped = true;
+        size_t next = 0;
+        for (const auto& group : groups)
+        {
+            for (const size_t i : group)
+            {
+                grouped = grouped && i == next++;
+            }
+        }
+
+        Arena nodes;
+        if (!grouped)
+        {
+            nodes.reserve(builder.nodes.size());
+        }
+
+        for (const auto& group : groups)
+        {
+            Predictor predictor;
+            predictor.begin = trees.size();
+
+            for (const size_t i : group)
+            {
+                if (grouped)
+                {
+                    trees.push_back(builder.trees[i]);
+                    continue;
+                }
+
+                const uint32_t begin = builder.trees[i].root;
+                const uint32_t end = i + 1 < builder.trees.size() ? builder.trees[i + 1].root : builder.nodes.size();
+
+                trees.push_back(Tree{relocate(builder.nodes.data() + begin, end - begin, begin, nodes)});
+            }
+
+            predictor.end = trees.size();
+            predictors.push_back(predictor);
+        }
+
+        if (grouped)
+        {
+            nodes = std::move(builder.nodes);
+        }
+        nodes.shrink_to_fit();
+
+        result.nodes = Array<Node>(std::move(nodes));
+        result.trees = Array<Tree>(std::move(trees));
+        result.predictors = Array<Predictor>(std::move(predictors));
+
+        // get objective and raw base score
+        const auto objective = builder.objective;
+        const auto base_score = std::stof(builder.base_score);
+
+        // transform base score according to the objective
+        auto transformBaseScore = [objective, base_score]()
+        {
+            if (objective == "reg:logistic" || objective == "binary:logistic" || objective == "binary:logitraw")
+            {
+                if (base_score <= 0.0f || base_score >= 1.0f)
+                {
+                    throw std::runtime_error("base_score must be in (0,1) for logistic loss, got: " + std::to_string(base_score));
+                }
+                return -std::log(1.0f / base_score - 1.0f);
+            }
+
+            if (objective == "reg:gamma" || objective == "reg:tweedie" || objective == "count:poisson" || objective == "survival:aft" || objective == "survival:cox")
+            {
+                return std::log(base_score);
+            }
+
+            return base_score;
+        };
+
+        // get transformation according to the objective
         auto transformation = [objective]()
         {
-            if (objective ==  "multi:softprob")
+            if (objective ==  "multi:softprob")
+            {
+                return Transformation::SOFTMAX;
+            }
+            else if (objective == "reg:logistic" || objective == "binary:logistic")
+            {
+                return Transformation::SIGMOID;
+            }
+            return Transformation::NONE;
+        };
+
+        result.base_score = transformBaseScore();
+        result.transformation = transformation();
+
+        return result;
+    }
+
+    //------------------------------------------------------------------------------
+    // load model from binary, UBJSON or JSON model file
+    // trees of text models are checked and packed in parallel on options executor
+    //------------------------------------------------------------------------------
+    static Model load(const std::string& modelFile, const Options& options)
+    {
+        const BinaryHeader header;
+        char magic[sizeof(header.magic)] = {};
+
+        std::ifstream stream(modelFile, std::ios::binary);
+        stream.read(magic, sizeof(magic));
+
+        if (stream && std::memcmp(magic, header.magic, sizeof(magic)) == 0)
+        {
+            return map(modelFile);
+        }
+
+        // UBJSON object starts with key length marker, JSON object with space or quote
+        if (stream.gcount() >= 2 && magic[0] == '{' && std::strchr("iUIlL", magic[1]) && magic[1] != '\0')
+        {
+            return parseUbjson(modelFile, options);
+        }
+
+        return parse(modelFile, options);
+    }
+
+    //------------------------------------------------------------------------------
+    // map binary model file, model arrays refer to the mapping
+    // read-only shared mapping: processes loading the same file share its pages
+    //------------------------------------------------------------------------------
+    static Model map(const std::string& binaryFile)
+    {
+        std::shared_ptr<const void> storage;
+        size_t size = 0;
+
+#ifdef XGBOOST_PREDICTOR_MMAP
+        const int fd = ::open(binaryFile.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw std::runtime_error("can't open binary model file: " + binaryFile);
+        }
+
+        struct stat status;
+        if (::fstat(fd, &status) != 0 || status.st_size < static_cast<off_t>(sizeof(BinaryHeader)))
+        {
+            ::close(fd);
+            throw std::runtime_error("invalid binary model file: " + binaryFile);
+        }
+        size = status.st_size;
+
+        void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED)
+        {
+            throw std::runtime_error("can't map binary model file: " + binaryFile);
+        }
+
+        storage = std::shared_ptr<const void>(mapping, [size](const void* mapping)
+        {
+            ::munmap(const_cast<void*>(mapping), size);
+        });
+#else
+        std::ifstream stream(binaryFile, std::ios::binary | std::ios::ate);
+        size = stream ? static_cast<size_t>(stream.tellg()) : 0;
+        stream.seekg(0);
+
+        auto buffer = std::make_shared<std::vector<char, AlignedAllocator<char>>>(size);
+        if (!stream.read(buffer->data(), size))
+        {
+            throw std::runtime_error("can't read binary model file: " + binaryFile);
+        }
+        storage = std::shared_ptr<const void>(buffer, buffer->data());
+#endif
+
+        const char* data = static_cast<const char*>(storage.get());
+
+        BinaryHeader header;
+        if (size < sizeof(header))
+        {
+            throw std::runtime_error("invalid binary model file: " + binaryFile);
+        }
+        std::memcpy(&header, data, sizeof(header));
+
+        if (header.version < 1 || header.version > BINARY_VERSION)
+        {
+            throw std::runtime_error("unsupported binary model version: " + std::to_string(header.version));
+        }
+
+        if (header.byte_order != BINARY_BYTE_ORDER || header.node_size != sizeof(Node) || header.file_size != size)
+        {
+            throw std::runtime_error("incompatible binary model file: " + binaryFile);
+        }
+
+        // section fits in file
+        auto section = [size](const uint64_t offset, const uint64_t count, const size_t itemSize)
+        {
+            return offset % BINARY_ALIGNMENT == 0 && offset >= sizeof(BinaryHeader) && offset <= size && count <= (size - offset) / itemSize;
+        };
+
+        if (!section(header.nodes_offset, header.nodes, sizeof(Node)) ||
+            !section(header.trees_offset, header.trees, sizeof(Tree)) ||
+            !section(header.predictors_offset, header.predictors, sizeof(Predictor)) ||
+            (header.features > 0 && !section(header.features_offset, header.features, sizeof(uint32_t))) ||
+            header.transformation > static_cast<uint32_t>(Transformation::SOFTMAX))
+        {
+            throw std::runtime_error("invalid binary model file: " + binaryFile);
+        }
+
+        if (checksum(data, size) != header.checksum)
+        {
+            throw std::runtime_error("binary model file checksum mismatch: " + binaryFile);
+        }
+
+        Model model;
+        model.nodes = Array<Node>(reinterpret_cast<const Node*>(data + header.nodes_offset), header.nodes, storage);
+        model.trees = Array<Tree>(reinterpret_cast<const Tree*>(data + header.trees_offset), header.trees, storage);
+        model.predictors = Array<Predictor>(reinterpret_cast<const Predictor*>(data + header.predictors_offset), header.predictors, storage);
+        model.features = Array<uint32_t>(reinterpret_cast<const uint32_t*>(data + header.features_offset), header.features, storage);
+        model.num_features = header.num_features;
+        model.base_score = header.base_score;
+        model.transformation = static_cast<Transformation>(header.transformation);
+
+        check(model);
+
+        return model;
+    }
+
+    //------------------------------------------------------------------------------
+    // checksum of binary model file, checksum field of header is taken as zero
+    //------------------------------------------------------------------------------
+    static uint64_t checksum(const char* data, const size_t size)
+    {
+        // FNV-1a over 64-bit words
+        uint64_t hash = 0xcbf29ce484222325ULL;
+
+        for (size_t i = 0; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+        {
+            uint64_t word = 0;
+            if (i != offsetof(BinaryHeader, checksum))
+            {
+                std::memcpy(&word, data + i, sizeof(word));
+            }
+            hash = (hash ^ word) * 0x100000001b3ULL;
+            hash ^= hash >> 32;
+        }
+
+        return hash;
+    }
+
+    //------------------------------------------------------------------------------
+    // check loaded model is valid: tree nodes are in preorder, so child offsets
+    // increasing within the tree guarantee traversal terminates in bounds
+    // children before the tree are subtrees of earlier, already checked trees
+    // (compacted models), trees only refer back, so traversal terminates as well
+    // a node has one parent within its tree (relayout keeps the order valid), a
+    // parent with both children on the same node counts once as in parsed trees
+    //------------------------------------------------------------------------------
+    static void check(const Model& model)
+    {
+        if (model.num_features > Node::FEATURE_MASK + 1ULL || (!model.features.empty() && model.features.size() != model.num_features))
+        {
+            throw std::runtime_error("invalid model");
+        }
+
+        for (const uint32_t feature : model.features)
+        {
+            if (feature > Node::FEATURE_MASK)
+            {
+                throw std::runtime_error("invalid model feature: " + std::to_string(feature));
+            }
+        }
+
+        for (const auto& predictor : model.predictors)
+        {
+            if (predictor.begin > predictor.end || predictor.end > model.trees.size())
+            {
+                throw std::runtime_error("invalid model predictor");
+            }
+        }
+
+        std::vector<uint8_t> parents(model.nodes.size(), 0);
+        const size_t first = model.trees.empty() ? 0 : model.trees[0].root;
+
+        for (size_t i = 0; i < model.trees.size(); ++i)
+        {
+            const size_t begin = model.trees[i].root;
+            const size_t end = i + 1 < model.trees.size() ? model.trees[i + 1].root : model.nodes.size();
+
+            if (begin >= end || end > model.nodes.size())
+            {
+                throw std::runtime_error("invalid model tree: " + std::to_string(i));
+            }
+
+            for (size_t index = begin; index < end; ++index)
+            {
+                const Node& node = model.nodes[index];
+
+                if (node.feature() >= model.num_features)
+                {
+                    throw std::runtime_error("invalid model node feature: " + std::to_string(node.feature()));
+                }
+
+                for (unsigned int child = 0; child < 2; ++child)
+                {
+                    const uint32_t offset = node.children[child].offset;
+                    if (node.isLeaf(child) || (offset < begin && offset >= first))
+                    {
+                        continue;
+                    }
+
+                    // both children on the same node
+                    if (child == 1 && !node.isLeaf(0) && node.children[0].offset == offset)
+                    {
+                        continue;
+                    }
+
+                    if (offset <= index || offset >= end || parents[offset]++)
+                    {
+                        throw std::runtime_error("invalid model node child: " + std::to_string(index));
+                    }
+                }
+            }
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // split tree table into blocks of at most tree_block_bytes nodes for batch prediction
+    // blocks do not cross predictor boundaries, result is block boundaries
+    //------------------------------------------------------------------------------
+    static std::vector<uint32_t> treeBlocks(const Model& model, const Options& options)
+    {
+        std::vector<uint32_t> blocks{0};
+
+        for (const auto& predictor : model.predictors)
+        {
+            size_t bytes = 0;
+
+            for (uint32_t i = predictor.begin; i < predictor.end; ++i)
+            {
+                const size_t end = i + 1 < model.trees.size() ? model.trees[i + 1].root : model.nodes.size();
+                const size_t size = (end - model.trees[i].root) * sizeof(Node);
+
+                if (options.tree_block_bytes > 0 && bytes > 0 && bytes + size > options.tree_block_bytes)
+                {
+                    blocks.push_back(i);
+                    bytes = 0;
+                }
+                bytes += size;
+            }
+
+            if (blocks.back() != predictor.end)
+            {
+                blocks.push_back(predictor.end);
+            }
+        }
+
+        return blocks;
+    }
+
+    //------------------------------------------------------------------------------
+    // interleave trees of multiclass predictors: round i has tree i of each predictor
+    // (xgboost tree_info order), empty for single predictor
+    //------------------------------------------------------------------------------
+    static std::vector<FusedTree> fusedTrees(const Model& model)
+    {
+        std::vector<FusedTree> result;
+
+        if (model.predictors.size() < 2)
+        {
+            return result;
+        }
+
+        result.reserve(model.trees.size());
+
+        for (uint32_t round = 0; result.size() < model.trees.size(); ++round)
+        {
+            for (uint32_t i = 0; i < model.predictors.size(); ++i)
+            {
+                const auto& predictor = model.predictors[i];
+                if (predictor.begin + round < predictor.end)
+                {
+                    FusedTree fused;
+                    fused.tree = predictor.begin + round;
+                    fused.predictor = i;
+                    result.push_back(fused);
+                }
+            }
+        }
+
+        return result;
+    }
+
+    //------------------------------------------------------------------------------
+    // split fused trees into blocks of at most tree_block_bytes nodes, result is block boundaries
+    //------------------------------------------------------------------------------
+    static std::vector<uint32_t> fusedBlocks(const Model& model, const std::vector<FusedTree>& fusedTrees, const Options& options)
+    {
+        std::vector<uint32_t> blocks{0};
+        size_t bytes = 0;
+
+        for (uint32_t i = 0; i < fusedTrees.size(); ++i)
+        {
+            const uint32_t tree = fusedTrees[i].tree;
+            const size_t end = tree + 1 < model.trees.size() ? model.trees[tree + 1].root : model.nodes.size();
+            const size_t size = (end - model.trees[tree].root) * sizeof(Node);
+
+            if (options.tree_block_bytes > 0 && bytes > 0 && bytes + size > options.tree_block_bytes)
+            {
+                blocks.push_back(i);
+                bytes = 0;
+            }
+            bytes += size;
+        }
+
+        if (blocks.back() != fusedTrees.size())
+        {
+            blocks.push_back(fusedTrees.size());
+        }
+
+        return blocks;
+    }
+
+    //------------------------------------------------------------------------------
+    // select batch prediction kernel according to options and CPU features
+    //------------------------------------------------------------------------------
+    static Simd simd(const Model& model, const Options& options)
+    {
+#ifdef XGBOOST_PREDICTOR_SIMD
+        // kernels address node words with 32-bit gather indices
+        if (options.simd && model.nodes.size() <= std::numeric_limits<int>::max() / 4)
+        {
+            if (__builtin_cpu_supports("avx512f"))
+            {
+                return Simd::AVX512;
+            }
+            if (__builtin_cpu_supports("avx2"))
+            {
+                return Simd::AVX2;
+            }
+        }
+#endif
+        return Simd::NONE;
+    }
+
+    //------------------------------------------------------------------------------
+    // compile QuickScorer engines of model predictors
+    //------------------------------------------------------------------------------
+    static std::vector<QuickScorer> quickScorers(const Model& model, const Options& options)
+    {
+        std::vector<QuickScorer> result;
+
+        if (options.engine != Engine::QUICKSCORER)
+        {
+            return result;
+        }
+
+        for (const auto& predictor : model.predictors)
+        {
+            // bitvector masks of false nodes
+            struct Entry
+            {
+                uint32_t feature;
+                float threshold;
+                bool missing;
+                QuickScorer::Mask mask;
+            };
+            std::vector<Entry> entries;
+
+            result.emplace_back();
+            auto& scorer = result.back();
+
+            for (uint32_t i = predictor.begin; i < predictor.end; ++i)
+            {
+                scorer.trees.push_back(scorer.words);
+                scorer.tree_leaves.push_back(scorer.leaves.size());
+
+                // number leaves left to right, false node clears leaves [begin, end) of its yes subtree
+                std::vector<QuickScorer::Split> splits;
+                collectLeaves(model, model.trees[i].root, scorer.leaves, splits);
+
+                const uint32_t first = scorer.tree_leaves.back();
+                const uint32_t words = (scorer.leaves.size() - first + 63) / 64;
+
+                for (const auto& split : splits)
+                {
+                    const Node& node = model.nodes[split.node];
+                    const uint32_t yesBegin = split.begin - first;
+                    const uint32_t yesEnd = split.end - first;
+
+                    for (uint32_t word = yesBegin / 64; word * 64 < yesEnd; ++word)
+                    {
+                        const uint32_t begin = std::max(yesBegin, word * 64) - word * 64;
+                        const uint32_t end = std::min(yesEnd, word * 64 + 64) - word * 64;
+                        const uint64_t bits = (end - begin == 64 ? ~0ULL : ((1ULL << (end - begin)) - 1) << begin);
+
+                        entries.push_back(Entry{node.feature(), node.value, !node.defaultLeft(), QuickScorer::Mask{scorer.words + word, ~bits}});
+                    }
+                }
+
+                scorer.words += words;
+            }
+            scorer.trees.push_back(scorer.words);
+
+            // sort entries by feature and threshold
+            std::stable_sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b)
+            {
+                return a.feature < b.feature || (a.feature == b.feature && a.threshold < b.threshold);
+            });
+
+            scorer.features.assign(model.num_features + 1, 0);
+            scorer.missing.assign(model.num_features + 1, 0);
+
+            for (size_t i = 0; i < entries.size(); ++i)
+            {
+                const auto& entry = entries[i];
+
+                scorer.thresholds.push_back(entry.threshold);
+                scorer.masks.push_back(entry.mask);
+                ++scorer.features[entry.feature + 1];
+
+                if (entry.missing)
+                {
+                    scorer.missing_masks.push_back(i);
+                    ++scorer.missing[entry.feature + 1];
+                }
+            }
+
+            for (size_t feature = 0; feature < model.num_features; ++feature)
+            {
+                scorer.features[feature + 1] += scorer.features[feature];
+                scorer.missing[feature + 1] += scorer.missing[feature];
+            }
+        }
+
+        return result;
+    }
+
+    //------------------------------------------------------------------------------
+    // compile quantized engines of model predictors
+    // without them (engine not selected, predictor with more than 8192 features or
+    // a feature with more than 65533 thresholds) trees are walked by the tree engine
+    //------------------------------------------------------------------------------
+    static std::vector<Quantized> quantize(const Model& model, const Options& options)
+    {
+        std::vector<Quantized> result;
+
+        if (options.engine != Engine::QUANTIZED)
+        {
+            return result;
+        }
+
+        for (const auto& predictor : model.predictors)
+        {
+            result.emplace_back();
+            auto& quantized = result.back();
+
+            // features and distinct thresholds of decision nodes, NaN threshold has no bin
+            std::vector<std::pair<uint32_t, float>> splits;
+            for (uint32_t tree = predictor.begin; tree < predictor.end; ++tree)
+            {
+                forEachNode(model, model.trees[tree].root, [&quantized, &splits](const Node& node)
+                {
+                    quantized.features.push_back(node.feature());
+                    if (!std::isnan(node.value))
+                    {
+                        splits.emplace_back(node.feature(), node.value);
+                    }
+                });
+            }
+
+            std::sort(quantized.features.begin(), quantized.features.end());
+            quantized.features.erase(std::unique(quantized.features.begin(), quantized.features.end()), quantized.features.end());
+            std::sort(splits.begin(), splits.end());
+            splits.erase(std::unique(splits.begin(), splits.end()), splits.end());
+
+            size_t maxThresholds = 0;
+            auto split = splits.begin();
+            for (const uint32_t feature : quantized.features)
+            {
+                quantized.offsets.push_back(quantized.thresholds.size());
+                for (; split != splits.end() && split->first == feature; ++split)
+                {
+                    quantized.thresholds.push_back(split->second);
+                }
+                maxThresholds = std::max<size_t>(maxThresholds, quantized.thresholds.size() - quantized.offsets.back());
+            }
+            quantized.offsets.push_back(quantized.thresholds.size());
+
+            if (quantized.features.size() > QuantizedNode::FEATURE_MASK + 1U || maxThresholds > std::numeric_limits<uint16_t>::max() - 2U)
+            {
+                return {};
+            }
+            quantized.wide = maxThresholds > std::numeric_limits<uint8_t>::max() - 2U;
+
+            // decision nodes in preorder, following yes children, pending no children on stack
+            std::vector<std::pair<uint32_t, uint32_t>> pending;     // node, parent in quantized nodes
+            for (uint32_t tree = predictor.begin; tree < predictor.end; ++tree)
+            {
+                quantized.roots.push_back(quantized.nodes.size());
+                pending.emplace_back(model.trees[tree].root, std::numeric_limits<uint32_t>::max());
+
+                while (!pending.empty())
+                {
+                    uint32_t index = pending.back().first;
+                    const uint32_t parent = pending.back().second;
+                    pending.pop_back();
+
+                    if (parent != std::numeric_limits<uint32_t>::max())
+                    {
+                        quantized.nodes[parent].no.offset = quantized.nodes.size();
+                    }
+
+                    while (true)
+                    {
+                        const Node& node = model.nodes[index];
+
+                        QuantizedNode quantizedNode;
+                        const size_t feature = std::lower_bound(quantized.features.begin(), quantized.features.end(), node.feature()) - quantized.features.begin();
+                        quantizedNode.info = feature;
+
+                        if (!std::isnan(node.value))
+                        {
+                            const float* begin = quantized.thresholds.data() + quantized.offsets[feature];
+                            const float* end = quantized.thresholds.data() + quantized.offsets[feature + 1];
+                            quantizedNode.bin = std::lower_bound(begin, end, node.value) - begin + 1;
+                        }
+
+                        quantizedNode.info |= node.isLeaf(0) ? QuantizedNode::YES_LEAF : 0;
+                        quantizedNode.info |= node.isLeaf(1) ? QuantizedNode::NO_LEAF : 0;
+                        quantizedNode.info |= node.defaultLeft() ? QuantizedNode::DEFAULT_LEFT : 0;
+
+                        if (node.isLeaf(1))
+                        {
+                            quantizedNode.no.value = node.children[1].value;
+                        }
+                        else
+                        {
+                            pending.emplace_back(node.children[1].offset, quantized.nodes.size());
+                        }
+
+                        quantized.nodes.push_back(quantizedNode);
+
+                        if (node.isLeaf(0))
+                        {
+                            // leaf slot
+                            QuantizedNode leaf;
+                            leaf.no.value = node.children[0].value;
+                            quantized.nodes.push_back(leaf);
+                            break;
+                        }
+
+                        index = node.children[0].offset;
+                    }
+                }
+            }
+        }
+
+        return result;
+    }
+
+    //------------------------------------------------------------------------------
+    // compacted copy of model (Options::compact): decision nodes with identical children
+    // are replaced by the child, trees of zero leaves only are dropped and subtrees
+    // identical to a subtree of an earlier tree refer to it, remap_features implies
+    // compaction and renumbers used features in original order
+    // predictions are identical, nodes keep the order of their children (see Layout)
+    // other single leaf trees are kept: the base score is shared by all predictors
+    // and adding their leaves to it would change the float sums
+    //------------------------------------------------------------------------------
+    static Model compact(Model&& model, const Options& options, CompactionStats& stats)
+    {
+        if (!options.compact && !options.remap_features)
+        {
+            return std::move(model);
+        }
+
+        auto bytes = [](const Model& model)
+        {
+            return model.nodes.size() * sizeof(Node) + model.trees.size() * sizeof(Tree) + model.predictors.size() * sizeof(Predictor) + model.features.size() * sizeof(uint32_t);
+        };
+
+        stats.nodes_before = model.nodes.size();
+        stats.trees_before = model.trees.size();
+        stats.bytes_before = bytes(model);
+        stats.features_before = model.num_features;
+
+        // distinct subtrees: nodes with leaf values or distinct subtree ids as children,
+        // equal nodes are identical subtrees
+        struct Hash
+        {
+            size_t operator()(const Node& node) const
+            {
+                uint32_t words[sizeof(Node) / sizeof(uint32_t)];
+                std::memcpy(words, &node, sizeof(words));
+
+                uint64_t hash = 0xcbf29ce484222325ULL;
+                for (const uint32_t word : words)
+                {
+                    hash = (hash ^ word) * 0x100000001b3ULL;
+                }
+                return hash ^ (hash >> 32);
+            }
+        };
+
+        struct Equal
+        {
+            bool operator()(const Node& a, const Node& b) const
+            {
+                return std::memcmp(&a, &b, sizeof(Node)) == 0;
+            }
+        };
+
+        std::vector<Node> distinct;
+        std::vector<uint8_t> noFirst;   // no child followed the first node of the subtree
+        std::unordered_map<Node, uint32_t, Hash, Equal> ids;
+
+        // node reduced to leaf value or distinct subtree id
+        std::vector<Node::Child> reduced(model.nodes.size());
+        std::vector<uint8_t> leaf(model.nodes.size(), 0);
+
+        for (size_t tree = 0; tree < model.trees.size(); ++tree)
+        {
+            // children follow their parent within the tree or belong to earlier trees
+            const uint32_t root = model.trees[tree].root;
+            const size_t end = tree + 1 < model.trees.size() ? model.trees[tree + 1].root : model.nodes.size();
+
+            for (size_t i = end; i-- > root;)
+            {
+                const Node& source = model.nodes[i];
+                Node node = source;
+
+                for (unsigned int child = 0; child < 2; ++child)
+                {
+                    if (!source.isLeaf(child))
+                    {
+                        node.children[child] = reduced[source.children[child].offset];
+                        node.info |= leaf[source.children[child].offset] ? (child ? Node::NO_LEAF : Node::YES_LEAF) : 0;
+                    }
+                }
+
+                if (node.isLeaf(0) == node.isLeaf(1) && node.children[0].offset == node.children[1].offset)
+                {
+                    // single leaf trees are stored this way, not counted
+                    stats.redundant_splits += !(i == root && source.isLeaf(0) && source.isLeaf(1));
+                    reduced[i] = node.children[0];
+                    leaf[i] = node.isLeaf(0);
+                    continue;
+                }
+
+                const auto inserted = ids.emplace(node, distinct.size());
+                if (inserted.second)
+                {
+                    distinct.push_back(node);
+                    noFirst.push_back(!source.isLeaf(1) && source.children[1].offset == i + 1);
+                }
+                reduced[i].offset = inserted.first->second;
+            }
+        }
+
+        // trees in preorder, the first copy of a distinct subtree is shared with later trees
+        constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+        std::vector<uint32_t> placed(distinct.size(), NONE);
+
+        struct Pending
+        {
+            uint32_t id;            // distinct subtree
+            uint32_t parent;        // parent node offset, NONE for root
+            unsigned int child;     // child of parent
+        };
+        std::vector<Pending> stack;
+
+        Arena nodes;
+        nodes.reserve(distinct.size() + model.trees.size());
+        std::vector<Tree> trees;
+        std::vector<Predictor> predictors;
+
+        for (const auto& predictor : model.predictors)
+        {
+            predictors.push_back(Predictor{static_cast<uint32_t>(trees.size()), static_cast<uint32_t>(trees.size())});
+
+            for (uint32_t tree = predictor.begin; tree < predictor.end; ++tree)
+            {
+                const uint32_t root = model.trees[tree].root;
+                const uint32_t begin = nodes.size();
+
+                if (leaf[root] && reduced[root].value == 0.0f)
+                {
+                    ++stats.zero_trees;
+                    continue;
+                }
+
+                trees.push_back(Tree{begin});
+                ++predictors.back().end;
+
+                if (leaf[root])
+                {
+                    // single leaf tree: both children of decision node on feature 0 lead to the leaf
+                    Node node;
+                    node.info = Node::YES_LEAF | Node::NO_LEAF;
+                    node.children[0] = reduced[root];
+                    node.children[1] = reduced[root];
+                    nodes.push_back(node);
+                    continue;
+                }
+
+                stack.push_back(Pending{reduced[root].offset, NONE, 0});
+
+                while (!stack.empty())
+                {
+                    const Pending pending = stack.back();
+                    stack.pop_back();
+
+                    if (pending.parent != NONE && placed[pending.id] < begin)
+                    {
+                        nodes[pending.parent].children[pending.child].offset = placed[pending.id];
+                        ++stats.shared_subtrees;
+                        continue;
+                    }
+
+                    const uint32_t offset = nodes.size();
+                    if (pending.parent != NONE)
+                    {
+                        nodes[pending.parent].children[pending.child].offset = offset;
+                    }
+                    if (placed[pending.id] == NONE)
+                    {
+                        placed[pending.id] = offset;
+                    }
+
+                    const Node& node = distinct[pending.id];
+                    nodes.push_back(node);
+
+                    for (const unsigned int child : {noFirst[pending.id] ? 0U : 1U, noFirst[pending.id] ? 1U : 0U})
+                    {
+                        if (!node.isLeaf(child))
+                        {
+                            stack.push_back(Pending{node.children[child].offset, offset, child});
+                        }
+                    }
+                }
+            }
+        }
+
+        Model result;
+        result.num_features = model.num_features;
+        result.features = model.features;
+        result.base_score = model.base_score;
+        result.transformation = model.transformation;
+
+        if (options.remap_features)
+        {
+            // model feature of used features, single leaf nodes split on model feature 0
+            std::vector<uint32_t> remap(model.num_features, NONE);
+            for (const auto& node : nodes)
             {
-                return Transformation::SOFTMAX;
+                if (!node.isLeaf(0) || !node.isLeaf(1) || node.children[0].offset != node.children[1].offset)
+                {
+                    remap[node.feature()] = 0;
+                }
             }
-            else if (objective == "reg:logistic" || objective == "binary:logistic")
+
+            std::vector<uint32_t> features;
+            for (uint32_t feature = 0; feature < remap.size(); ++feature)
             {
-                return Transformation::SIGMOID;
+                if (remap[feature] != NONE)
+                {
+                    remap[feature] = features.size();
+                    features.push_back(model.features.empty() ? feature : model.features[feature]);
+                }
             }
-            return Transformation::NONE;
+            if (features.empty() && !nodes.empty())
+            {
+                features.push_back(model.features.empty() ? 0 : model.features[0]);
+            }
+
+            bool identity = true;
+            for (uint32_t i = 0; i < features.size(); ++i)
+            {
+                identity &= features[i] == i;
+            }
+
+            for (auto& node : nodes)
+            {
+                const uint32_t feature = remap[node.feature()];
+                node.info = (node.info & ~Node::FEATURE_MASK) | (feature == NONE ? 0 : feature);
+            }
+
+            result.num_features = features.size();
+            result.features = identity ? Array<uint32_t>() : Array<uint32_t>(std::move(features));
+        }
+
+        result.nodes = Array<Node>(std::move(nodes));
+        result.trees = Array<Tree>(std::move(trees));
+        result.predictors = Array<Predictor>(std::move(predictors));
+
+        stats.nodes_after = result.nodes.size();
+        stats.trees_after = result.trees.size();
+        stats.bytes_after = bytes(result);
+        stats.features_after = result.num_features;
+
+        return result;
+    }
+
+    //------------------------------------------------------------------------------
+    // copy of model with decision nodes of each tree in preorder visiting the child
+    // with more hits first (yes on ties), so the hot child follows its parent
+    // trees keep their order and node ranges, hitCounts are two per node (see hitCounts)
+    // subtrees shared with earlier trees (compacted models) stay shared
+    //------------------------------------------------------------------------------
+    static Model relayout(const Model& model, const std::vector<uint64_t>& hitCounts)
+    {
+        if (hitCounts.size() != model.nodes.size() * 2)
+        {
+            throw std::runtime_error("hit counts do not match model nodes: " + std::to_string(hitCounts.size()) + " != " + std::to_string(model.nodes.size() * 2));
+        }
+
+        // new order of nodes, tree by tree
+        std::vector<uint32_t> order;
+        order.reserve(model.nodes.size());
+        std::vector<uint32_t> stack;
+        std::vector<uint8_t> visited(model.nodes.size(), 0);
+
+        for (const auto& tree : model.trees)
+        {
+            stack.assign(1, tree.root);
+            visited[tree.root] = 1;
+
+            while (!stack.empty())
+            {
+                const uint32_t index = stack.back();
+                stack.pop_back();
+                order.push_back(index);
+
+                const Node& node = model.nodes[index];
+                const bool noFirst = hitCounts[index * 2 + 1] > hitCounts[index * 2];
+
+                for (const unsigned int child : {noFirst ? 0U : 1U, noFirst ? 1U : 0U})
+                {
+                    if (!node.isLeaf(child) && !visited[node.children[child].offset])
+                    {
+                        visited[node.children[child].offset] = 1;
+                        stack.push_back(node.children[child].offset);
+                    }
+                }
+            }
+        }
+
+        if (order.size() != model.nodes.size())
+        {
+            throw std::runtime_error("invalid model");
+        }
+
+        // new offsets of nodes
+        std::vector<uint32_t> offsets(model.nodes.size());
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            offsets[order[i]] = i;
+        }
+
+        Arena nodes;
+        nodes.reserve(order.size());
+        for (const uint32_t index : order)
+        {
+            Node node = model.nodes[index];
+            for (unsigned int child = 0; child < 2; ++child)
+            {
+                if (!node.isLeaf(child))
+                {
+                    node.children[child].offset = offsets[node.children[child].offset];
+                }
+            }
+            nodes.push_back(node);
+        }
+
+        std::vector<Tree> trees;
+        trees.reserve(model.trees.size());
+        for (const auto& tree : model.trees)
+        {
+            trees.push_back(Tree{offsets[tree.root]});
+        }
+
+        Model result = model;
+        result.nodes = Array<Node>(std::move(nodes));
+        result.trees = Array<Tree>(std::move(trees));
+        return result;
+    }
+
+    //------------------------------------------------------------------------------
+    // copy of model with decision nodes on shared features[0, count) resolved by
+    // their values, remaining nodes of each tree in preorder
+    //------------------------------------------------------------------------------
+    static Model specialize(const Model& model, const uint32_t* features, const float* values, const size_t count)
+    {
+        // shared value of model features, NaN: missing
+        std::vector<uint8_t> shared(model.num_features, 0);
+        std::vector<float> sharedValues(model.num_features);
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (features[i] < model.num_features)
+            {
+                shared[features[i]] = 1;
+                sharedValues[features[i]] = values[i];
+            }
+        }
+
+        // follow child of node past decision nodes on shared features,
+        // returns whether the resolved child is leaf
+        auto resolve = [&model, &shared, &sharedValues](bool leaf, Node::Child& child)
+        {
+            while (!leaf && shared[model.nodes[child.offset].feature()])
+            {
+                const Node& node = model.nodes[child.offset];
+                const float value = sharedValues[node.feature()];
+
+                // NaN compares false, missing value follows default direction
+                const unsigned int next = (value < node.value) | (std::isnan(value) & node.defaultLeft()) ? 0 : 1;
+                leaf = node.isLeaf(next);
+                child = node.children[next];
+            }
+            return leaf;
+        };
+
+        Arena nodes;
+        nodes.reserve(model.nodes.size());
+        std::vector<Tree> trees;
+        trees.reserve(model.trees.size());
+
+        // decision nodes in preorder, following yes children, pending no children on stack
+        constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+        std::vector<std::pair<uint32_t, uint32_t>> pending;     // node, parent in residual nodes
+
+        for (const auto& tree : model.trees)
+        {
+            trees.push_back(Tree{static_cast<uint32_t>(nodes.size())});
+
+            Node::Child root;
+            root.offset = tree.root;
+            if (resolve(false, root))
+            {
+                // single leaf tree: both children of decision node on feature 0 lead to the leaf
+                Node node;
+                node.info = Node::YES_LEAF | Node::NO_LEAF;
+                node.children[0].value = root.value;
+                node.children[1].value = root.value;
+                nodes.push_back(node);
+                continue;
+            }
+
+            pending.emplace_back(root.offset, NONE);
+
+            while (!pending.empty())
+            {
+                uint32_t index = pending.back().first;
+                uint32_t parent = pending.back().second;
+                unsigned int parentChild = 1;
+                pending.pop_back();
+
+                while (true)
+                {
+                    const Node& source = model.nodes[index];
+                    const uint32_t offset = nodes.size();
+                    if (parent != NONE)
+                    {
+                        nodes[parent].children[parentChild].offset = offset;
+                    }
+
+                    Node node;
+                    node.value = source.value;
+                    node.info = source.info & ~(Node::YES_LEAF | Node::NO_LEAF);
+
+                    Node::Child no = source.children[1];
+                    if (resolve(source.isLeaf(1), no))
+                    {
+                        node.info |= Node::NO_LEAF;
+                        node.children[1] = no;
+                    }
+                    else
+                    {
+                        pending.emplace_back(no.offset, offset);
+                    }
+
+                    Node::Child yes = source.children[0];
+                    const bool leaf = resolve(source.isLeaf(0), yes);
+                    if (leaf)
+                    {
+                        node.info |= Node::YES_LEAF;
+                        node.children[0] = yes;
+                    }
+                    nodes.push_back(node);
+
+                    if (leaf)
+                    {
+                        break;
+                    }
+
+                    index = yes.offset;
+                    parent = offset;
+                    parentChild = 0;
+                }
+            }
+        }
+
+        Model result = model;
+        result.nodes = Array<Node>(std::move(nodes));
+        result.trees = Array<Tree>(std::move(trees));
+        return result;
+    }
+
+    //------------------------------------------------------------------------------
+    // min/max leaf of each tree, summed over trees to the end of their predictor
+    // float sum of n values differs from the exact sum by at most n * eps * sum |values|
+    // (eps = 2^-23, twice the unit roundoff), the slack is doubled for the partial sum
+    //------------------------------------------------------------------------------
+    static TreeBounds treeBounds(const Model& model)
+    {
+        TreeBounds result;
+        result.min.resize(model.trees.size());
+        result.max.resize(model.trees.size());
+        std::vector<uint32_t> stack;
+
+        for (size_t tree = 0; tree < model.trees.size(); ++tree)
+        {
+            double min = std::numeric_limits<double>::infinity();
+            double max = -std::numeric_limits<double>::infinity();
+
+            forEachNode(model, model.trees[tree].root, [&min, &max](const Node& node)
+            {
+                for (unsigned int child = 0; child < 2; ++child)
+                {
+                    if (node.isLeaf(child))
+                    {
+                        min = std::min<double>(min, node.children[child].value);
+                        max = std::max<double>(max, node.children[child].value);
+                    }
+                }
+            }, stack);
+
+            result.min[tree] = min;
+            result.max[tree] = max;
+        }
+
+        for (const auto& predictor : model.predictors)
+        {
+            double magnitude = std::abs(model.base_score);
+            for (uint32_t tree = predictor.end; tree-- > predictor.begin;)
+            {
+                magnitude += std::max(std::abs(result.min[tree]), std::abs(result.max[tree]));
+                if (tree + 1 < predictor.end)
+                {
+                    result.min[tree] += result.min[tree + 1];
+                    result.max[tree] += result.max[tree + 1];
+                }
+            }
+
+            const double n = predictor.end - predictor.begin + 1;
+            result.slack.push_back(2 * n * std::numeric_limits<float>::epsilon() * magnitude);
+        }
+
+        return result;
+    }
+
+    //------------------------------------------------------------------------------
+    // index trees by the features they split on
+    //------------------------------------------------------------------------------
+    static FeatureIndex featureIndex(const Model& model)
+    {
+        FeatureIndex result;
+
+        result.predictors.resize(model.trees.size());
+        for (uint32_t predictor = 0; predictor < model.predictors.size(); ++predictor)
+        {
+            for (uint32_t tree = model.predictors[predictor].begin; tree < model.predictors[predictor].end; ++tree)
+            {
+                result.predictors[tree] = predictor;
+            }
+        }
+
+        // trees per feature, a tree is counted once per feature (last tree seen)
+        constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+        std::vector<uint32_t> last(model.num_features, NONE);
+        result.offsets.assign(model.num_features + 1, 0);
+
+        std::vector<uint32_t> stack;
+
+        auto forEachFeature = [&model, &last, &stack](const auto& function)
+        {
+            for (uint32_t tree = 0; tree < model.trees.size(); ++tree)
+            {
+                forEachNode(model, model.trees[tree].root, [&last, &function, tree](const Node& node)
+                {
+                    const uint32_t feature = node.feature();
+                    if (last[feature] != tree)
+                    {
+                        last[feature] = tree;
+                        function(feature, tree);
+                    }
+                }, stack);
+            }
+        };
+
+        forEachFeature([&result](const uint32_t feature, uint32_t)
+        {
+            ++result.offsets[feature + 1];
+        });
+
+        for (size_t i = 1; i < result.offsets.size(); ++i)
+        {
+            result.offsets[i] += result.offsets[i - 1];
+        }
+
+        // trees of each feature in tree table order
+        result.trees.resize(result.offsets.back());
+        std::vector<uint32_t> next(result.offsets.begin(), result.offsets.end() - 1);
+        last.assign(model.num_features, NONE);
+
+        forEachFeature([&result, &next](const uint32_t feature, const uint32_t tree)
+        {
+            result.trees[next[feature]++] = tree;
+        });
+
+        return result;
+    }
+
+    //------------------------------------------------------------------------------
+    // run function(node) for decision nodes of tree, without recursion
+    //------------------------------------------------------------------------------
+    template<typename Function>
+    static void forEachNode(const Model& model, const uint32_t root, const Function& function)
+    {
+        std::vector<uint32_t> stack;
+        forEachNode(model, root, function, stack);
+    }
+
+    //------------------------------------------------------------------------------
+    // run function(node) for decision nodes of tree, reusing stack buffer
+    //------------------------------------------------------------------------------
+    template<typename Function>
+    static void forEachNode(const Model& model, const uint32_t root, const Function& function, std::vector<uint32_t>& stack)
+    {
+        stack.assign(1, root);
+
+        while (!stack.empty())
+        {
+            const Node& node = model.nodes[stack.back()];
+            stack.pop_back();
+
+            function(node);
+
+            for (unsigned int child = 0; child < 2; ++child)
+            {
+                if (!node.isLeaf(child))
+                {
+                    stack.push_back(node.children[child].offset);
+                }
+            }
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // collect tree leaves left to right and leaf ranges of yes subtrees of decision nodes
+    // (in order of their no children), iterative with explicit stack like forEachNode
+    //------------------------------------------------------------------------------
+    static void collectLeaves(const Model& model, const uint32_t root, std::vector<float>& leaves, std::vector<QuickScorer::Split>& splits)
+    {
+        // decision node, first leaf of its yes subtree, yes subtree is collected
+        struct Frame
+        {
+            uint32_t index;
+            uint32_t begin;
+            bool yes;
         };
+        std::vector<Frame> stack{Frame{root, 0, false}};
+
+        while (!stack.empty())
+        {
+            Frame& frame = stack.back();
+            const Node& node = model.nodes[frame.index];
+            const unsigned int child = frame.yes ? 1 : 0;
+
+            if (!frame.yes)
+            {
+                frame.begin = leaves.size();
+                frame.yes = true;
+            }
+            else
+            {
+                splits.push_back(QuickScorer::Split{frame.index, frame.begin, static_cast<uint32_t>(leaves.size())});
+                stack.pop_back();
+            }
+
+            if (node.isLeaf(child))
+            {
+                leaves.push_back(node.children[child].value);
+            }
+            else
+            {
+                stack.push_back(Frame{node.children[child].offset, 0, false});
+            }
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // pack parsed tree into node arena, decision nodes in preorder (children follow
+    // their parent), leaf nodes are stored inline in their parents
+    // tree is checked, its preorder is in scratch, numFeatures is updated with features of the tree
+    //------------------------------------------------------------------------------
+    static Tree pack(const ParsedTree& tree, TreeScratch& scratch, Arena& nodes, uint32_t& numFeatures)
+    {
+        const Tree result{static_cast<uint32_t>(nodes.size())};
+
+        // single leaf tree: both children of decision node on feature 0 lead to the leaf
+        if (tree[0].feature < 0)
+        {
+            numFeatures = std::max(numFeatures, 1U);
+
+            Node node;
+            node.info = Node::YES_LEAF | Node::NO_LEAF;
+            node.children[0].value = tree[0].value;
+            node.children[1].value = tree[0].value;
+            nodes.push_back(node);
+            return result;
+        }
+
+        const auto& order = scratch.order;
+
+        if (nodes.size() + order.size() > std::numeric_limits<uint32_t>::max())
+        {
+            throw std::runtime_error("too many tree nodes");
+        }
+
+        // arena offsets of decision nodes
+        auto& offsets = scratch.offsets;
+        offsets.resize(tree.size());
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            offsets[order[i]] = nodes.size() + i;
+        }
+
+        for (const unsigned int index : order)
+        {
+            const auto& parsed = tree[index];
+
+            if (static_cast<uint32_t>(parsed.feature) > Node::FEATURE_MASK)
+            {
+                throw std::runtime_error("feature index out of range: " + std::to_string(parsed.feature));
+            }
+
+            Node node;
+            node.value = parsed.value;
+            node.info = static_cast<uint32_t>(parsed.feature) | (parsed.default_left ? Node::DEFAULT_LEFT : 0);
+            numFeatures = std::max(numFeatures, static_cast<uint32_t>(parsed.feature) + 1);
+
+            const unsigned int children[] = {parsed.yes, parsed.no};
+            for (unsigned int i = 0; i < 2; ++i)
+            {
+                const auto& child = tree[children[i]];
+                if (child.feature < 0)
+                {
+                    node.info |= i ? Node::NO_LEAF : Node::YES_LEAF;
+                    node.children[i].value = child.value;
+                }
+                else
+                {
+                    node.children[i].offset = offsets[children[i]];
+                }
+            }
+
+            nodes.push_back(node);
+        }
+
+        return result;
+    }
+
+    //------------------------------------------------------------------------------
+    // append count nodes packed at arena offset begin to nodes, relocating child
+    // offsets, returns new offset of first node
+    //------------------------------------------------------------------------------
+    static uint32_t relocate(const Node* source, const size_t count, const uint32_t begin, Arena& nodes)
+    {
+        if (nodes.size() + count > std::numeric_limits<uint32_t>::max())
+        {
+            throw std::runtime_error("too many tree nodes");
+        }
+
+        const uint32_t result = nodes.size();
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            Node node = source[i];
+            for (unsigned int child = 0; child < 2; ++child)
+            {
+                if (!node.isLeaf(child))
+                {
+                    node.children[child].offset = node.children[child].offset - begin + result;
+                }
+            }
+            nodes.push_back(node);
+        }
 
-        return Model{std::move(predictors), transformBaseScore(), transformation()};
+        return result;
     }
 
     //------------------------------------------------------------------------------
-    // check tree is valid
+    // check tree is valid: indices are in range, every decision node is reached
+    // once from the root (no cycles), preorder of decision nodes is left in scratch
+    // iterative, buffers of scratch are reused between trees
     //------------------------------------------------------------------------------
-    static void check(const Tree& tree)
+    static void check(const ParsedTree& tree, TreeScratch& scratch)
     {
         if (tree.empty())
         {
@@ -451,42 +5276,47 @@ private:
         {
             if (node.feature >= 0)
             {
-                if (node.yes > tree.size() || node.no > tree.size() || node.missing > tree.size())
+                if (node.yes >= tree.size() || node.no >= tree.size())
                 {
-                    throw std::runtime_error("tree yes/no/missing index out of range");
+                    throw std::runtime_error("tree yes/no index out of range");
                 }
             }
         }
 
-        // check there are no cycles
-        std::vector<bool> visited(tree.size());
-        check(tree, 0, visited);
-    }
+        // depth-first traversal, subtree of child with larger cover first (yes on ties),
+        // so the hot child follows its parent in preorder
+        auto& visited = scratch.visited;
+        auto& stack = scratch.stack;
+        auto& order = scratch.order;
 
-    //------------------------------------------------------------------------------
-    // check tree has no cycles
-    //------------------------------------------------------------------------------
-    static void check(const Tree& tree, const size_t index, std::vector<bool>& visited)
-    {
-        const auto& node = tree[index];
+        visited.assign(tree.size(), 0);
+        order.clear();
+        stack.assign(1, 0);
 
-        if (node.feature >= 0)
+        while (!stack.empty())
         {
+            const unsigned int index = stack.back();
+            stack.pop_back();
+
+            const auto& node = tree[index];
+            if (node.feature < 0)
+            {
+                continue;
+            }
+
             if (visited[index])
             {
                 throw std::runtime_error("cycle in tree");
             }
-            visited[index] = true;
+            visited[index] = 1;
+            order.push_back(index);
 
-            check(tree, node.yes, visited);
+            const bool noFirst = tree[node.no].cover > tree[node.yes].cover;
             if (node.no != node.yes)
             {
-                check(tree, node.no, visited);
-            }
-            if (node.missing != node.yes && node.missing != node.no)
-            {
-                check(tree, node.missing, visited);
+                stack.push_back(noFirst ? node.yes : node.no);
             }
+            stack.push_back(noFirst ? node.no : node.yes);
         }
     }
 
@@ -520,7 +5350,20 @@ private:
 
 
 private:
+    const Options m_options;
+    CompactionStats m_compactionStats;          // set while compacting the model
     const Model m_model;
+    const std::vector<uint32_t> m_treeBlocks;   // tree table block boundaries for batch prediction
+    const Simd m_simd;                          // dense batch prediction kernel
+    const std::vector<QuickScorer> m_quickScorers;  // QuickScorer engines of predictors
+    const std::vector<Quantized> m_quantized;       // quantized engines of predictors
+    const std::shared_ptr<TreeParallelCounters> m_treeParallelStats;
+    const std::shared_ptr<std::vector<std::atomic<uint64_t>>> m_hitCounts;    // branch counts of nodes (count_hits), two per node
+    const std::shared_ptr<ProfileRegistry> m_profile;   // hot path profile counters of threads (Options::profile)
+    const FeatureIndex m_featureIndex;              // trees of features for incremental rescoring (Session)
+    const TreeBounds m_treeBounds;                  // suffix bounds of tree sums for bounded prediction
+    const std::vector<FusedTree> m_fusedTrees;      // interleaved trees of multiclass predictors
+    const std::vector<uint32_t> m_fusedBlocks;      // fused tree block boundaries for batch prediction
 };
 
 //------------------------------------------------------------------------------
@@ -0,0 +1,332 @@
+#pragma once
+
+#include "xgboostpredictor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace xgboost::predictor
+{
+
+//------------------------------------------------------------------------------
+
+// asynchronous front-end coalescing concurrent single row requests into batches
+// a batch is dispatched when it reaches max_batch rows or when its first row has
+// waited max_wait, a dispatcher thread predicts it through the batch path
+// (predictMatrix) and completes its requests in submission order
+// predictions are the same as of predict(data), batching trades the wait of
+// a row for throughput under concurrent load
+class XGBoostPredictorBatcher
+{
+public:
+    // batching options
+    struct Options
+    {
+        size_t max_batch = 64;                                  // max rows of a batch
+        std::chrono::microseconds max_wait{200};                // max time the first row of a batch waits for more rows
+        size_t threads = 1;                                     // dispatcher threads (batches predicted at once)
+    };
+
+    // queue and batch statistics, mean batch size = rows / batches
+    struct Stats
+    {
+        uint64_t requests = 0;          // rows submitted
+        uint64_t rows = 0;              // rows dispatched
+        uint64_t batches = 0;           // batches dispatched
+        uint64_t full_batches = 0;      // batches dispatched at max_batch rows, the others at max_wait
+        uint64_t max_batch = 0;         // rows of largest batch
+        uint64_t queue_depth = 0;       // rows waiting for dispatch
+        uint64_t max_queue_depth = 0;   // max rows waiting for dispatch at once
+        uint64_t queue_ns = 0;          // total time of rows from submission to dispatch
+        uint64_t predict_ns = 0;        // total time of batch predictions
+    };
+
+    // completion of request: predictions of the row, or error with empty predictions
+    // called on a dispatcher thread, exceptions thrown by it are ignored
+    using Callback = std::function<void(std::vector<float> predictions, std::exception_ptr error)>;
+
+    //------------------------------------------------------------------------------
+    // create batcher of predictor, start dispatcher threads
+    //------------------------------------------------------------------------------
+    explicit XGBoostPredictorBatcher(std::shared_ptr<const XGBoostPredictor> predictor)
+        :XGBoostPredictorBatcher(std::move(predictor), Options())
+    {}
+
+    //------------------------------------------------------------------------------
+    // create batcher of predictor with options, start dispatcher threads
+    //------------------------------------------------------------------------------
+    XGBoostPredictorBatcher(std::shared_ptr<const XGBoostPredictor> predictor, const Options& options)
+        :m_predictor(std::move(predictor))
+        ,m_options(options)
+        ,m_stats(std::make_shared<Counters>())
+    {
+        if (!m_predictor || m_options.max_batch == 0)
+        {
+            throw std::runtime_error("invalid batcher options");
+        }
+
+        for (size_t i = 0; i < std::max<size_t>(m_options.threads, 1); ++i)
+        {
+            m_dispatchers.emplace_back([this]()
+            {
+                dispatch();
+            });
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // complete waiting requests, stop dispatcher threads
+    //------------------------------------------------------------------------------
+    ~XGBoostPredictorBatcher()
+    {
+        {
+            const std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_condition.notify_all();
+
+        for (auto& dispatcher : m_dispatchers)
+        {
+            dispatcher.join();
+        }
+    }
+
+    XGBoostPredictorBatcher(const XGBoostPredictorBatcher&) = delete;
+    XGBoostPredictorBatcher& operator=(const XGBoostPredictorBatcher&) = delete;
+
+    //------------------------------------------------------------------------------
+    // submit row, future of its predictions
+    //------------------------------------------------------------------------------
+    std::future<std::vector<float>> submit(XGBoostPredictor::Data data, const bool outputMargin = false)
+    {
+        auto promise = std::make_shared<std::promise<std::vector<float>>>();
+        auto future = promise->get_future();
+
+        submit(std::move(data), [promise](std::vector<float> predictions, const std::exception_ptr error)
+        {
+            if (error)
+            {
+                promise->set_exception(error);
+            }
+            else
+            {
+                promise->set_value(std::move(predictions));
+            }
+        }, outputMargin);
+
+        return future;
+    }
+
+    //------------------------------------------------------------------------------
+    // submit row, callback is called with its predictions
+    //------------------------------------------------------------------------------
+    void submit(XGBoostPredictor::Data data, Callback callback, const bool outputMargin = false)
+    {
+        size_t depth = 0;
+        {
+            const std::lock_guard<std::mutex> lock(m_mutex);
+            m_queue.push_back(Request{std::move(data), std::move(callback), outputMargin, Clock::now()});
+            depth = m_queue.size();
+            m_stats->queue_depth = depth;
+        }
+
+        ++m_stats->requests;
+        uint64_t max = m_stats->max_queue_depth;
+        while (depth > max && !m_stats->max_queue_depth.compare_exchange_weak(max, depth))
+        {
+        }
+
+        // first row starts the wait of an idle dispatcher, full batch ends it
+        if (depth == 1 || depth >= m_options.max_batch)
+        {
+            m_condition.notify_all();
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // queue and batch statistics
+    //------------------------------------------------------------------------------
+    Stats stats() const
+    {
+        Stats stats;
+        stats.requests = m_stats->requests;
+        stats.rows = m_stats->rows;
+        stats.batches = m_stats->batches;
+        stats.full_batches = m_stats->full_batches;
+        stats.max_batch = m_stats->max_batch;
+        stats.queue_depth = m_stats->queue_depth;
+        stats.max_queue_depth = m_stats->max_queue_depth;
+        stats.queue_ns = m_stats->queue_ns;
+        stats.predict_ns = m_stats->predict_ns;
+        return stats;
+    }
+
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // submitted row
+    struct Request
+    {
+        XGBoostPredictor::Data data;
+        Callback callback;
+        bool output_margin = false;
+        Clock::time_point submitted;
+    };
+
+    // statistics counters
+    struct Counters
+    {
+        std::atomic<uint64_t> requests{0};
+        std::atomic<uint64_t> rows{0};
+        std::atomic<uint64_t> batches{0};
+        std::atomic<uint64_t> full_batches{0};
+        std::atomic<uint64_t> max_batch{0};
+        std::atomic<uint64_t> queue_depth{0};
+        std::atomic<uint64_t> max_queue_depth{0};
+        std::atomic<uint64_t> queue_ns{0};
+        std::atomic<uint64_t> predict_ns{0};
+    };
+
+
+private:
+    //------------------------------------------------------------------------------
+    // dispatcher loop: collect batch, predict it, complete its requests
+    // on stop the queue is drained without waiting
+    //------------------------------------------------------------------------------
+    void dispatch()
+    {
+        std::vector<Request> batch;
+        std::vector<XGBoostPredictor::Data> rows;
+        std::vector<float> scores;
+        const size_t predictors = m_predictor->numPredictors();
+
+        while (true)
+        {
+            batch.clear();
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_condition.wait(lock, [this]()
+                {
+                    return m_stop || !m_queue.empty();
+                });
+
+                if (m_queue.empty())
+                {
+                    return;
+                }
+
+                const auto deadline = m_queue.front().submitted + m_options.max_wait;
+                m_condition.wait_until(lock, deadline, [this]()
+                {
+                    return m_stop || m_queue.size() >= m_options.max_batch;
+                });
+
+                // another dispatcher took the rows
+                if (m_queue.empty())
+                {
+                    continue;
+                }
+
+                const size_t size = std::min(m_queue.size(), m_options.max_batch);
+                for (size_t i = 0; i < size; ++i)
+                {
+                    batch.push_back(std::move(m_queue.front()));
+                    m_queue.pop_front();
+                }
+                m_stats->queue_depth = m_queue.size();
+
+                // remaining rows start the wait of the next batch
+                if (!m_queue.empty())
+                {
+                    m_condition.notify_one();
+                }
+            }
+
+            const auto start = Clock::now();
+
+            rows.clear();
+            uint64_t queued = 0;
+            for (auto& request : batch)
+            {
+                rows.push_back(std::move(request.data));
+                queued += nanoseconds(start - request.submitted);
+            }
+
+            std::exception_ptr error;
+            try
+            {
+                scores.resize(rows.size() * predictors);
+                m_predictor->predictMatrix(rows, scores.data(), scores.size(), true);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+
+            m_stats->predict_ns += nanoseconds(Clock::now() - start);
+            m_stats->queue_ns += queued;
+            m_stats->rows += batch.size();
+            ++m_stats->batches;
+            m_stats->full_batches += batch.size() == m_options.max_batch;
+            uint64_t max = m_stats->max_batch;
+            while (batch.size() > max && !m_stats->max_batch.compare_exchange_weak(max, batch.size()))
+            {
+            }
+
+            for (size_t i = 0; i < batch.size(); ++i)
+            {
+                std::vector<float> predictions;
+                if (!error)
+                {
+                    predictions.assign(scores.begin() + i * predictors, scores.begin() + (i + 1) * predictors);
+                    if (!batch[i].output_margin)
+                    {
+                        m_predictor->transformMargins(predictions.data(), predictions.size(), predictions.size());
+                    }
+                }
+
+                try
+                {
+                    batch[i].callback(std::move(predictions), error);
+                }
+                catch (...)
+                {
+                }
+            }
+        }
+    }
+
+    template<typename Duration>
+    static uint64_t nanoseconds(const Duration& duration)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+    }
+
+
+private:
+    const std::shared_ptr<const XGBoostPredictor> m_predictor;
+    const Options m_options;
+    const std::shared_ptr<Counters> m_stats;
+
+    std::mutex m_mutex;                     // guards queue and stop flag
+    std::condition_variable m_condition;    // rows submitted, batch full or stop
+    std::deque<Request> m_queue;
+    bool m_stop = false;
+
+    std::vector<std::thread> m_dispatchers;
+};
+
+//------------------------------------------------------------------------------
+
+} // namespaces
@@ -0,0 +1,529 @@
+#pragma once
+
+#include "xgboostpredictor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace xgboost::predictor
+{
+
+//------------------------------------------------------------------------------
+
+// thread-safe holder of predictor replaceable while serving (RCU style)
+// a new model is loaded aside and published atomically, readers take no shared locks:
+// each thread has a slot of the holder with the predictor it uses, a call marks the
+// slot in use with an atomic exchange on entry and exit (contended by swap() only)
+// swap() puts the new predictor into every idle slot, slots in use take it when
+// their calls end, so a retired predictor is released as soon as the in-flight calls
+// on it finish (or when the thread drops a predictor() reference by its next call)
+// the holder registers the slot of a thread at its first call, slots of exited
+// threads are dropped by the next swap, a destroyed holder empties all its slots
+class XGBoostPredictorHolder
+{
+public:
+    // swap metrics
+    struct Stats
+    {
+        uint64_t swaps = 0;             // predictors published
+        uint64_t failed_loads = 0;      // reloads failed, previous predictor kept
+        uint64_t load_ns = 0;           // load time of last published predictor
+        uint64_t swap_ns = 0;           // publish time of last swap
+        uint64_t live = 0;              // predictors alive (current, retired still in use and acquired)
+        uint64_t overlap_ns = 0;        // last time from retiring a predictor to its release
+        uint64_t max_overlap_ns = 0;    // max time from retiring a predictor to its release
+    };
+
+    //------------------------------------------------------------------------------
+    // create holder with predictor of model file
+    //------------------------------------------------------------------------------
+    explicit XGBoostPredictorHolder(const std::string& modelFile, const XGBoostPredictor::Options& options = XGBoostPredictor::Options())
+        :m_id(nextId())
+        ,m_alive(std::make_shared<const uint64_t>(m_id))
+        ,m_modelFile(modelFile)
+        ,m_options(options)
+        ,m_stats(std::make_shared<Counters>())
+    {
+        reload();
+    }
+
+    //------------------------------------------------------------------------------
+    // stop watching model file, release predictor of calling thread
+    //------------------------------------------------------------------------------
+    ~XGBoostPredictorHolder()
+    {
+        auto& cache = threadCache();
+        cache.erase(std::remove_if(cache.begin(), cache.end(), [this](const CacheEntry& entry)
+        {
+            return entry.holder == m_id;
+        }), cache.end());
+
+        {
+            const std::lock_guard<std::mutex> lock(m_watchMutex);
+            m_stop = true;
+        }
+        m_watchCondition.notify_all();
+
+        if (m_watcher.joinable())
+        {
+            m_watcher.join();
+        }
+
+        // slots in caches of other threads are pruned at their next use of another holder
+        std::vector<std::shared_ptr<const XGBoostPredictor>> released;
+        const std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& slot : m_slots)
+        {
+            const std::lock_guard<Slot> slotLock(*slot);
+            released.push_back(std::move(slot->predictor));
+            released.push_back(std::move(slot->next));
+        }
+    }
+
+    XGBoostPredictorHolder(const XGBoostPredictorHolder&) = delete;
+    XGBoostPredictorHolder& operator=(const XGBoostPredictorHolder&) = delete;
+
+    //------------------------------------------------------------------------------
+    // current predictor, the reference is valid until the next predictor() call
+    // of the calling thread (use acquire() to keep a predictor longer)
+    // the slot of the thread stays in use until then, so a predictor retired in
+    // between is released only by that call (predict() does not hold it)
+    //------------------------------------------------------------------------------
+    const XGBoostPredictor& predictor() const
+    {
+        auto& entry = threadEntry();
+        if (entry.pinned)
+        {
+            entry.pinned = false;
+            leave(*entry.slot);
+        }
+
+        const auto& predictor = enter(*entry.slot);
+        entry.pinned = true;
+        return predictor;
+    }
+
+    //------------------------------------------------------------------------------
+    // make prediction on current predictor
+    //------------------------------------------------------------------------------
+    template<typename... Args>
+    auto predict(Args&&... args) const
+    {
+        const Use use(*threadEntry().slot);
+        return use.predictor.predict(std::forward<Args>(args)...);
+    }
+
+    //------------------------------------------------------------------------------
+    // current predictor, kept alive by the returned pointer
+    //------------------------------------------------------------------------------
+    std::shared_ptr<const XGBoostPredictor> acquire() const
+    {
+        const std::lock_guard<std::mutex> lock(m_mutex);
+        return m_current;
+    }
+
+    //------------------------------------------------------------------------------
+    // load model file again and publish it, on error the current predictor is kept
+    //------------------------------------------------------------------------------
+    void reload()
+    {
+        std::string modelFile;
+        {
+            const std::lock_guard<std::mutex> lock(m_reloadMutex);
+            modelFile = m_modelFile;
+        }
+
+        reload(modelFile);
+    }
+
+    //------------------------------------------------------------------------------
+    // load model file and publish it, following reloads use this file
+    //------------------------------------------------------------------------------
+    void reload(const std::string& modelFile)
+    {
+        const std::lock_guard<std::mutex> lock(m_reloadMutex);
+
+        const auto start = Clock::now();
+
+        std::shared_ptr<const XGBoostPredictor> predictor;
+        try
+        {
+            predictor = std::make_shared<const XGBoostPredictor>(modelFile, m_options);
+        }
+        catch (...)
+        {
+            ++m_stats->failed_loads;
+            throw;
+        }
+
+        m_stats->load_ns = nanoseconds(Clock::now() - start);
+        m_modelFile = modelFile;
+
+        swap(std::move(predictor));
+    }
+
+    //------------------------------------------------------------------------------
+    // load model file in background thread and publish it
+    // the holder must outlive the reload, which runs on this; the destructor of the
+    // returned future waits for the reload (std::async), a discarded result blocks
+    // the caller until the model is published
+    //------------------------------------------------------------------------------
+    std::future<void> reloadAsync(const std::string& modelFile)
+    {
+        return std::async(std::launch::async, [this, modelFile]()
+        {
+            reload(modelFile);
+        });
+    }
+
+    //------------------------------------------------------------------------------
+    // publish predictor
+    //------------------------------------------------------------------------------
+    void swap(std::shared_ptr<const XGBoostPredictor> predictor)
+    {
+        const auto start = Clock::now();
+
+        // tracked reference: release of the last copy records overlap window
+        auto lifetime = std::make_shared<Lifetime>();
+        auto stats = m_stats;
+        std::shared_ptr<const XGBoostPredictor> tracked(predictor.get(), [predictor, lifetime, stats](const XGBoostPredictor*) mutable
+        {
+            const int64_t retired = lifetime->retired.load();
+            if (retired != 0)
+            {
+                const uint64_t overlap = nanoseconds(Clock::now().time_since_epoch()) - retired;
+                stats->overlap_ns = overlap;
+
+                uint64_t max = stats->max_overlap_ns;
+                while (overlap > max && !stats->max_overlap_ns.compare_exchange_weak(max, overlap))
+                {
+                }
+            }
+            --stats->live;
+            predictor.reset();
+        });
+
+        ++m_stats->live;
+
+        // predictors taken out of slots, released after unlocking
+        std::vector<std::shared_ptr<const XGBoostPredictor>> released;
+        {
+            const std::lock_guard<std::mutex> lock(m_mutex);
+
+            if (m_lifetime)
+            {
+                m_lifetime->retired = nanoseconds(Clock::now().time_since_epoch());
+            }
+
+            released.push_back(std::move(m_current));
+            m_current = std::move(tracked);
+            m_lifetime = std::move(lifetime);
+
+            for (const auto& slot : m_slots)
+            {
+                const std::lock_guard<Slot> slotLock(*slot);
+                if (slot.use_count() == 1)
+                {
+                    // only referenced by holder: its thread exited, slot is dropped
+                    released.push_back(std::move(slot->predictor));
+                    released.push_back(std::move(slot->next));
+                }
+                else if (slot->users == 0)
+                {
+                    released.push_back(std::exchange(slot->predictor, m_current));
+                }
+                else
+                {
+                    released.push_back(std::exchange(slot->next, m_current));
+                }
+            }
+
+            m_slots.erase(std::remove_if(m_slots.begin(), m_slots.end(), [](const std::shared_ptr<Slot>& slot)
+            {
+                return slot.use_count() == 1;
+            }), m_slots.end());
+        }
+
+        ++m_stats->swaps;
+        m_stats->swap_ns = nanoseconds(Clock::now() - start);
+
+        // retired predictor is released here, unless calls on it are in flight (or acquired)
+    }
+
+    //------------------------------------------------------------------------------
+    // reload model file in background when its modification time or size changes,
+    // checked every interval, zero interval stops watching
+    // model file should be replaced atomically (written aside and renamed)
+    //------------------------------------------------------------------------------
+    void watch(const std::chrono::milliseconds interval)
+    {
+        {
+            const std::lock_guard<std::mutex> lock(m_watchMutex);
+            m_stop = true;
+        }
+        m_watchCondition.notify_all();
+
+        if (m_watcher.joinable())
+        {
+            m_watcher.join();
+        }
+
+        if (interval.count() <= 0)
+        {
+            return;
+        }
+
+        m_stop = false;
+        m_watcher = std::thread([this, interval, version = fileVersion()]() mutable
+        {
+            std::unique_lock<std::mutex> lock(m_watchMutex);
+            while (!m_watchCondition.wait_for(lock, interval, [this]() { return m_stop; }))
+            {
+                const auto current = fileVersion();
+                if (current == version)
+                {
+                    continue;
+                }
+                version = current;
+
+                lock.unlock();
+                try
+                {
+                    reload();
+                }
+                catch (const std::exception&)
+                {
+                    // counted in failed_loads, current predictor is kept
+                }
+                lock.lock();
+            }
+        });
+    }
+
+    //------------------------------------------------------------------------------
+    // swap metrics
+    //------------------------------------------------------------------------------
+    Stats stats() const
+    {
+        Stats stats;
+        stats.swaps = m_stats->swaps;
+        stats.failed_loads = m_stats->failed_loads;
+        stats.load_ns = m_stats->load_ns;
+        stats.swap_ns = m_stats->swap_ns;
+        stats.live = m_stats->live;
+        stats.overlap_ns = m_stats->overlap_ns;
+        stats.max_overlap_ns = m_stats->max_overlap_ns;
+        return stats;
+    }
+
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // predictor of a thread, written by the thread and by swap() under spin lock,
+    // which is held for pointer moves only (BasicLockable)
+    struct Slot
+    {
+        void lock()
+        {
+            while (locked.exchange(true, std::memory_order_acquire))
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        void unlock()
+        {
+            locked.store(false, std::memory_order_release);
+        }
+
+        std::atomic<bool> locked{false};
+        uint32_t users = 0;                                 // calls of thread on predictor (predict, predictor)
+        std::shared_ptr<const XGBoostPredictor> predictor;  // current when unused, replaced by swap()
+        std::shared_ptr<const XGBoostPredictor> next;       // published while in use, taken when last call ends
+    };
+
+    // slot of a holder in cache of a thread
+    struct CacheEntry
+    {
+        uint64_t holder = 0;
+        std::weak_ptr<const uint64_t> alive;    // expires with holder
+        std::shared_ptr<Slot> slot;
+        bool pinned = false;                    // slot in use by reference of predictor()
+    };
+
+    // slot in use during predict call
+    struct Use
+    {
+        explicit Use(Slot& slot)
+            :slot(slot)
+            ,predictor(enter(slot))
+        {}
+
+        ~Use()
+        {
+            leave(slot);
+        }
+
+        Use(const Use&) = delete;
+        Use& operator=(const Use&) = delete;
+
+        Slot& slot;
+        const XGBoostPredictor& predictor;
+    };
+
+    // retirement time of published predictor (steady clock ns, 0 = current)
+    struct Lifetime
+    {
+        std::atomic<int64_t> retired{0};
+    };
+
+    // swap metrics counters, shared with predictor deleters
+    struct Counters
+    {
+        std::atomic<uint64_t> swaps{0};
+        std::atomic<uint64_t> failed_loads{0};
+        std::atomic<uint64_t> load_ns{0};
+        std::atomic<uint64_t> swap_ns{0};
+        std::atomic<uint64_t> live{0};
+        std::atomic<uint64_t> overlap_ns{0};
+        std::atomic<uint64_t> max_overlap_ns{0};
+    };
+
+
+private:
+    //------------------------------------------------------------------------------
+    // mark slot in use, predictor stays alive until leave()
+    //------------------------------------------------------------------------------
+    static const XGBoostPredictor& enter(Slot& slot)
+    {
+        const std::lock_guard<Slot> lock(slot);
+        ++slot.users;
+        return *slot.predictor;
+    }
+
+    //------------------------------------------------------------------------------
+    // end use of slot, last call takes predictor published meanwhile and releases
+    // the retired one (the last reference records the overlap window)
+    //------------------------------------------------------------------------------
+    static void leave(Slot& slot)
+    {
+        std::shared_ptr<const XGBoostPredictor> retired;
+
+        const std::lock_guard<Slot> lock(slot);
+        if (--slot.users == 0 && slot.next)
+        {
+            retired = std::move(slot.predictor);
+            slot.predictor = std::move(slot.next);
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // cache entry of calling thread, slot is registered at first use of holder
+    //------------------------------------------------------------------------------
+    CacheEntry& threadEntry() const
+    {
+        auto& cache = threadCache();
+        for (auto& entry : cache)
+        {
+            if (entry.holder == m_id)
+            {
+                return entry;
+            }
+        }
+
+        // entries of destroyed holders
+        cache.erase(std::remove_if(cache.begin(), cache.end(), [](const CacheEntry& entry)
+        {
+            return entry.alive.expired();
+        }), cache.end());
+
+        auto slot = std::make_shared<Slot>();
+        {
+            const std::lock_guard<std::mutex> lock(m_mutex);
+            slot->predictor = m_current;
+            m_slots.push_back(slot);
+        }
+
+        cache.emplace_back();
+        cache.back().holder = m_id;
+        cache.back().alive = m_alive;
+        cache.back().slot = std::move(slot);
+        return cache.back();
+    }
+
+    //------------------------------------------------------------------------------
+    // slots of calling thread, one entry per live holder
+    //------------------------------------------------------------------------------
+    static std::vector<CacheEntry>& threadCache()
+    {
+        thread_local std::vector<CacheEntry> cache;
+        return cache;
+    }
+
+    //------------------------------------------------------------------------------
+    // unique holder id, holders at the same address do not share cache entries
+    //------------------------------------------------------------------------------
+    static uint64_t nextId()
+    {
+        static std::atomic<uint64_t> id{0};
+        return ++id;
+    }
+
+    //------------------------------------------------------------------------------
+    // model file modification time and size
+    //------------------------------------------------------------------------------
+    std::pair<std::filesystem::file_time_type, uintmax_t> fileVersion() const
+    {
+        std::string modelFile;
+        {
+            const std::lock_guard<std::mutex> lock(m_reloadMutex);
+            modelFile = m_modelFile;
+        }
+
+        std::error_code error;
+        const auto time = std::filesystem::last_write_time(modelFile, error);
+        const auto size = std::filesystem::file_size(modelFile, error);
+        return {time, size};
+    }
+
+    template<typename Duration>
+    static uint64_t nanoseconds(const Duration& duration)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+    }
+
+
+private:
+    const uint64_t m_id;
+    const std::shared_ptr<const uint64_t> m_alive;  // id, expires with holder (prunes thread cache entries)
+    std::string m_modelFile;
+    const XGBoostPredictor::Options m_options;
+
+    mutable std::mutex m_mutex;                     // guards current predictor and slots (writers, slot registration)
+    std::shared_ptr<const XGBoostPredictor> m_current;
+    std::shared_ptr<Lifetime> m_lifetime;           // lifetime of current predictor
+    mutable std::vector<std::shared_ptr<Slot>> m_slots;
+
+    mutable std::mutex m_reloadMutex;               // serializes reloads, guards model file
+    const std::shared_ptr<Counters> m_stats;
+
+    std::thread m_watcher;
+    std::mutex m_watchMutex;
+    std::condition_variable m_watchCondition;
+    bool m_stop = false;
+};
+
+//------------------------------------------------------------------------------
+
+} // namespaces
@@ -0,0 +1,254 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace xgboost::predictor
+{
+
+//------------------------------------------------------------------------------
+
+// executor of parallel tasks
+class Executor
+{
+public:
+    virtual ~Executor() = default;
+
+    //------------------------------------------------------------------------------
+    // run task(0) .. task(tasks - 1), return when all tasks are finished
+    // first exception thrown by a task is rethrown
+    //------------------------------------------------------------------------------
+    virtual void parallelFor(const size_t tasks, const std::function<void(size_t)>& task) = 0;
+
+    //------------------------------------------------------------------------------
+    // number of threads running tasks
+    //------------------------------------------------------------------------------
+    virtual size_t concurrency() const = 0;
+};
+
+//------------------------------------------------------------------------------
+
+// thread-safe pool of worker threads, calling thread works on its tasks too
+// idle workers claim tasks of pending jobs one by one, so fast workers take over
+// tasks of slow ones
+// for low latency jobs workers may be pinned to CPUs and spin before going to sleep
+class ThreadPool : public Executor
+{
+public:
+    //------------------------------------------------------------------------------
+    // create pool of threads (including calling thread)
+    // pin: pin worker i to CPU i (Linux only)
+    // spin: time an idle worker polls for new jobs before it sleeps
+    //------------------------------------------------------------------------------
+    explicit ThreadPool(const size_t threads = std::thread::hardware_concurrency(), const bool pin = false,
+            const std::chrono::microseconds spin = std::chrono::microseconds(0))
+        :m_spin(spin)
+    {
+        for (size_t i = 1; i < threads; ++i)
+        {
+            m_workers.emplace_back([this]()
+            {
+                work();
+            });
+
+#ifdef __linux__
+            if (pin)
+            {
+                cpu_set_t cpus;
+                CPU_ZERO(&cpus);
+                CPU_SET(i % std::max(1U, std::thread::hardware_concurrency()), &cpus);
+                pthread_setaffinity_np(m_workers.back().native_handle(), sizeof(cpus), &cpus);
+            }
+#else
+            static_cast<void>(pin);
+#endif
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // stop workers
+    //------------------------------------------------------------------------------
+    ~ThreadPool() override
+    {
+        {
+            const std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_condition.notify_all();
+
+        for (auto& worker : m_workers)
+        {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    //------------------------------------------------------------------------------
+    // run tasks on workers and calling thread
+    //------------------------------------------------------------------------------
+    void parallelFor(const size_t tasks, const std::function<void(size_t)>& task) override
+    {
+        if (tasks == 0)
+        {
+            return;
+        }
+
+        const auto job = std::make_shared<Job>(task, tasks);
+
+        if (tasks > 1 && !m_workers.empty())
+        {
+            {
+                const std::lock_guard<std::mutex> lock(m_mutex);
+                m_jobs.push_back(job);
+                ++m_pending;
+            }
+            m_condition.notify_all();
+        }
+
+        run(*job);
+
+        std::unique_lock<std::mutex> lock(job->mutex);
+        job->condition.wait(lock, [&job]()
+        {
+            return job->done == job->tasks;
+        });
+
+        if (job->error)
+        {
+            std::rethrow_exception(job->error);
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // number of threads running tasks
+    //------------------------------------------------------------------------------
+    size_t concurrency() const override
+    {
+        return m_workers.size() + 1;
+    }
+
+
+private:
+    // parallel job, tasks are claimed by atomic counter
+    struct Job
+    {
+        Job(const std::function<void(size_t)>& task, const size_t tasks)
+            :task(task)
+            ,tasks(tasks)
+        {}
+
+        const std::function<void(size_t)>& task;
+        const size_t tasks;
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::exception_ptr error;
+    };
+
+
+private:
+    //------------------------------------------------------------------------------
+    // run unclaimed tasks of job
+    //------------------------------------------------------------------------------
+    static void run(Job& job)
+    {
+        for (size_t i = job.next++; i < job.tasks; i = job.next++)
+        {
+            try
+            {
+                job.task(i);
+            }
+            catch (...)
+            {
+                const std::lock_guard<std::mutex> lock(job.mutex);
+                if (!job.error)
+                {
+                    job.error = std::current_exception();
+                }
+            }
+
+            if (++job.done == job.tasks)
+            {
+                const std::lock_guard<std::mutex> lock(job.mutex);
+                job.condition.notify_all();
+            }
+        }
+    }
+
+    //------------------------------------------------------------------------------
+    // worker loop
+    //------------------------------------------------------------------------------
+    void work()
+    {
+        while (true)
+        {
+            // poll for new job before sleeping
+            if (m_spin.count() > 0)
+            {
+                const auto until = std::chrono::steady_clock::now() + m_spin;
+                while (!m_pending && !m_stop && std::chrono::steady_clock::now() < until)
+                {
+                    std::this_thread::yield();
+                }
+            }
+
+            std::shared_ptr<Job> job;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_condition.wait(lock, [this]()
+                {
+                    return m_stop || !m_jobs.empty();
+                });
+
+                if (m_stop)
+                {
+                    return;
+                }
+
+                // drop job with all tasks claimed
+                job = m_jobs.front();
+                if (job->next >= job->tasks)
+                {
+                    m_jobs.pop_front();
+                    --m_pending;
+                    continue;
+                }
+            }
+
+            run(*job);
+        }
+    }
+
+
+private:
+    std::vector<std::thread> m_workers;
+    std::deque<std::shared_ptr<Job>> m_jobs;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::atomic<bool> m_stop{false};
+
+    const std::chrono::microseconds m_spin;
+    std::atomic<size_t> m_pending{0};       // jobs in queue, polled by spinning workers
+};
+
+//------------------------------------------------------------------------------
+
+} // namespaces
@@ -0,0 +1,724 @@
+#include <benchmark/benchmark.h>
+
+#include "xgboostpredictor.h"
+#include "xgboostpredictorbatcher.h"
+#include "info_model.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <thread>
+
+#include <malloc.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+namespace xgboost::predictor
+{
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+
+//------------------------------------------------------------------------------
+
+// uniform random value in [min, max) from the top 24 bits of mt19937 output,
+// the same on every standard library (unlike std::uniform_real_distribution)
+float uniform(std::mt19937& generator, const float min, const float max)
+{
+    return min + (max - min) * static_cast<float>(generator() >> 8) * 0x1p-24f;
+}
+
+//------------------------------------------------------------------------------
+
+// random rows with missing features
+std::vector<XGBoostPredictor::Data> rows(const size_t count, const size_t features)
+{
+    std::mt19937 generator(42);
+
+    std::vector<XGBoostPredictor::Data> result(count, XGBoostPredictor::Data(features));
+    for (auto& row : result)
+    {
+        for (auto& feature : row)
+        {
+            if (generator() % 3)
+            {
+                feature = uniform(generator, -20.0f, 500.0f);
+            }
+        }
+    }
+
+    return result;
+}
+
+//------------------------------------------------------------------------------
+
+// synthetic model parameters
+struct SyntheticModel
+{
+    size_t trees = 100;     // trees per class
+    size_t depth = 6;       // complete trees of 2^depth leaves
+    size_t features = 100;
+    size_t classes = 1;     // > 1: multi:softprob, binary:logistic otherwise
+    float missing = 0.3f;   // missing value rate of rows
+};
+
+//------------------------------------------------------------------------------
+
+// write XGBoost JSON model of random splits, deterministic for its parameters,
+// thresholds are in the value range of rows, leaves in [-0.25, 0.25), result is model file
+std::string syntheticModelFile(const SyntheticModel& model)
+{
+    const std::string file = (std::filesystem::temp_directory_path() / ("synthetic_" + std::to_string(model.trees) + "_" +
+            std::to_string(model.depth) + "_" + std::to_string(model.features) + "_" + std::to_string(model.classes) + ".model.json")).string();
+
+    std::mt19937 generator(42);
+
+    std::ofstream stream(file);
+    stream << R"({"learner": {"gradient_booster": {"model": {"trees": [)";
+
+    // nodes in breadth-first order: children of node i are 2i + 1 and 2i + 2
+    const size_t splits = (size_t(1) << model.depth) - 1;
+    const size_t nodes = 2 * splits + 1;
+    for (size_t tree = 0; tree < model.trees * model.classes; ++tree)
+    {
+        std::string defaultLeft, left, right, indices, conditions;
+        for (size_t i = 0; i < nodes; ++i)
+        {
+            const std::string separator = i ? ", " : "";
+            const bool split = i < splits;
+            defaultLeft += separator + (split && generator() % 2 ? "true" : "false");
+            left += separator + std::to_string(split ? static_cast<long>(2 * i + 1) : -1L);
+            right += separator + std::to_string(split ? static_cast<long>(2 * i + 2) : -1L);
+            indices += separator + std::to_string(split ? generator() % model.features : 0);
+            conditions += separator + std::to_string(split ? uniform(generator, -20.0f, 500.0f) : uniform(generator, -0.25f, 0.25f));
+        }
+
+        stream << (tree ? ", " : "") << R"({"default_left": [)" << defaultLeft << R"(], "left_children": [)" << left <<
+                R"(], "right_children": [)" << right << R"(], "split_indices": [)" << indices << R"(], "split_conditions": [)" << conditions << "]}";
+    }
+
+    stream << R"(], "tree_info": [)";
+    for (size_t tree = 0; tree < model.trees * model.classes; ++tree)
+    {
+        stream << (tree ? ", " : "") << tree % model.classes;
+    }
+    stream << R"(]}}, "learner_model_param": {"base_score": "5E-1", "num_class": ")" << (model.classes > 1 ? model.classes : 0) <<
+            R"("}, "objective": {"name": ")" << (model.classes > 1 ? "multi:softprob" : "binary:logistic") << R"("}}})";
+
+    return file;
+}
+
+//------------------------------------------------------------------------------
+
+// random dense rows of synthetic model, NaN value is missing feature
+std::vector<float> syntheticRows(const SyntheticModel& model, const size_t count)
+{
+    std::mt19937 generator(42);
+
+    std::vector<float> result(count * model.features);
+    for (auto& feature : result)
+    {
+        feature = uniform(generator, 0.0f, 1.0f) < model.missing ? std::numeric_limits<float>::quiet_NaN() : uniform(generator, -20.0f, 500.0f);
+    }
+
+    return result;
+}
+
+//------------------------------------------------------------------------------
+
+// resident (VmRSS) or peak resident (VmHWM) memory of process in kB, 0 if unknown
+long residentKB(const std::string& field)
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, field.size() + 1, field + ":") == 0)
+        {
+            return std::atol(line.c_str() + field.size() + 1);
+        }
+    }
+    return 0;
+}
+
+// peak resident memory of loading model file in kB, measured in a forked child
+// above its resident memory after releasing free heap memory, so that models
+// loaded earlier by the benchmark process do not count, -1 on error
+double loadPeakKB(const std::string& file)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        return -1;
+    }
+
+    const pid_t child = fork();
+    if (child == 0)
+    {
+        close(fds[0]);
+        malloc_trim(0);
+        std::ofstream("/proc/self/clear_refs") << "5";     // reset peak resident memory to current
+        const long before = residentKB("VmRSS");
+
+        long peak = -1;
+        try
+        {
+            const XGBoostPredictor predictor(file);
+            peak = std::max(residentKB("VmHWM"), residentKB("VmRSS")) - before;
+        }
+        catch (const std::exception&)
+        {
+        }
+
+        const ssize_t written = write(fds[1], &peak, sizeof(peak));
+        _exit(written == sizeof(peak) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    long peak = -1;
+    if (child < 0 || read(fds[0], &peak, sizeof(peak)) != sizeof(peak))
+    {
+        peak = -1;
+    }
+    close(fds[0]);
+    if (child > 0)
+    {
+        waitpid(child, nullptr, 0);
+    }
+    return peak;
+}
+
+//------------------------------------------------------------------------------
+
+XGBoostPredictor::Options options(const XGBoostPredictor::Engine engine)
+{
+    XGBoostPredictor::Options result;
+    result.engine = engine;
+    return result;
+}
+
+//------------------------------------------------------------------------------
+
+} // namespace
+
+//------------------------------------------------------------------------------
+
+void PredictRow(benchmark::State& state, const XGBoostPredictor::Engine engine)
+{
+    const XGBoostPredictor predictor("data/info.model.json", options(engine));
+    const auto data = rows(1000, 240);
+
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(predictor.predict(data[i++ % data.size()], true));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_CAPTURE(PredictRow, Tree, XGBoostPredictor::Engine::TREE);
+BENCHMARK_CAPTURE(PredictRow, QuickScorer, XGBoostPredictor::Engine::QUICKSCORER);
+BENCHMARK_CAPTURE(PredictRow, Quantized, XGBoostPredictor::Engine::QUANTIZED);
+
+//------------------------------------------------------------------------------
+
+// single row prediction recording latency (Options::profile) and tracing every
+// n-th row (Options::profile_sample, Arg, 0 = off)
+void PredictRowProfiled(benchmark::State& state)
+{
+    XGBoostPredictor::Options options;
+    options.profile = true;
+    options.profile_sample = state.range(0);
+    const XGBoostPredictor predictor("data/info.model.json", options);
+    const auto data = rows(1000, 240);
+
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(predictor.predict(data[i++ % data.size()], true));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(PredictRowProfiled)->Arg(0)->Arg(1)->Arg(100);
+
+//------------------------------------------------------------------------------
+
+// decide whether probability reaches cutoff, average evaluated trees in counter
+void PredictBounded(benchmark::State& state, const float probability)
+{
+    const XGBoostPredictor predictor("data/info.model.json");
+    const auto data = rows(1000, 240);
+    const float cutoff = std::log(probability / (1.0f - probability));
+
+    size_t i = 0;
+    uint64_t trees = 0;
+    for (auto _ : state)
+    {
+        const auto result = predictor.predictBounded(data[i++ % data.size()], cutoff);
+        benchmark::DoNotOptimize(result.above);
+        trees += result.trees;
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["trees"] = static_cast<double>(trees) / state.iterations();
+}
+
+BENCHMARK_CAPTURE(PredictBounded, P10, 0.1f);
+BENCHMARK_CAPTURE(PredictBounded, P50, 0.5f);
+BENCHMARK_CAPTURE(PredictBounded, P90, 0.9f);
+
+//------------------------------------------------------------------------------
+
+void PredictRowBuffer(benchmark::State& state)
+{
+    const XGBoostPredictor predictor("data/info.model.json");
+    const auto data = rows(1000, 240);
+    float prediction = 0.0f;
+
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        predictor.predict(data[i++ % data.size()], &prediction, 1);
+        benchmark::DoNotOptimize(prediction);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(PredictRowBuffer);
+
+//------------------------------------------------------------------------------
+
+void PredictRowCompiled(benchmark::State& state)
+{
+    const test::InfoModel predictor; // generated from data/info.model.json
+    const auto data = rows(1000, 240);
+
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(predictor.predict(data[i++ % data.size()], true));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(PredictRowCompiled);
+
+//------------------------------------------------------------------------------
+
+// rescore row after changing state.range(0) features: session update vs full prediction
+void Rescore(benchmark::State& state, const bool session)
+{
+    const XGBoostPredictor predictor("data/info.model.json");
+    std::vector<float> row(predictor.numFeatures());
+    for (size_t i = 0; i < row.size(); ++i)
+    {
+        row[i] = 2.0f * i - 14.58f;
+    }
+    XGBoostPredictor::Session scorer(predictor, row.data(), row.size());
+
+    const size_t changed = state.range(0);
+    std::vector<uint32_t> features(changed);
+    std::vector<float> values(changed);
+    std::vector<float> scores(predictor.numPredictors());
+
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        for (size_t j = 0; j < changed; ++j, ++i)
+        {
+            features[j] = (i * 37) % row.size();
+            values[j] = 0.5f * (i % 1000) - 20.0f;
+            row[features[j]] = values[j];
+        }
+
+        if (session)
+        {
+            scorer.update(features.data(), values.data(), changed);
+            scorer.predict(scores.data(), scores.size(), true);
+        }
+        else
+        {
+            predictor.predict(row.data(), row.size(), scores.data(), scores.size(), true);
+        }
+        benchmark::DoNotOptimize(scores.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_CAPTURE(Rescore, Predict, false)->Arg(1)->Arg(4);
+BENCHMARK_CAPTURE(Rescore, Session, true)->Arg(1)->Arg(4);
+
+//------------------------------------------------------------------------------
+
+void PredictBatch(benchmark::State& state, const XGBoostPredictor::Engine engine)
+{
+    const XGBoostPredictor predictor("data/info.model.json", options(engine));
+    const auto data = rows(state.range(0), 240);
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(predictor.predict(data, true));
+    }
+    state.SetItemsProcessed(state.iterations() * data.size());
+}
+
+BENCHMARK_CAPTURE(PredictBatch, Tree, XGBoostPredictor::Engine::TREE)->Arg(64)->Arg(1024);
+BENCHMARK_CAPTURE(PredictBatch, QuickScorer, XGBoostPredictor::Engine::QUICKSCORER)->Arg(64)->Arg(1024);
+BENCHMARK_CAPTURE(PredictBatch, Quantized, XGBoostPredictor::Engine::QUANTIZED)->Arg(64)->Arg(1024);
+
+//------------------------------------------------------------------------------
+
+// node layout: model file preorder, sum_hessian of model file or hit counts of replayed traffic
+void PredictLayout(benchmark::State& state, const XGBoostPredictor::Layout layout, const bool hits)
+{
+    XGBoostPredictor::Options options;
+    options.layout = layout;
+    options.count_hits = hits;
+    auto predictor = std::make_shared<const XGBoostPredictor>("data/info.model.json", options);
+    const auto data = rows(1000, 240);
+
+    // replay traffic to record branch counts, then relayout by them
+    if (hits)
+    {
+        predictor->predict(data, true);
+        predictor = std::make_shared<const XGBoostPredictor>(*predictor, predictor->hitCounts(), XGBoostPredictor::Options());
+    }
+
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(predictor->predict(data[i++ % data.size()], true));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_CAPTURE(PredictLayout, Preorder, XGBoostPredictor::Layout::PREORDER, false);
+BENCHMARK_CAPTURE(PredictLayout, Cover, XGBoostPredictor::Layout::COVER, false);
+BENCHMARK_CAPTURE(PredictLayout, Hits, XGBoostPredictor::Layout::PREORDER, true);
+
+//------------------------------------------------------------------------------
+
+// rank 64 candidates sharing 1 / state.range(0) of features (query features):
+// full rows vs residual predictor specialized per query (specialization included)
+void RankQuery(benchmark::State& state, const bool specialize)
+{
+    const XGBoostPredictor predictor("data/info.model.json");
+    const size_t columns = predictor.numFeatures();
+    const size_t share = state.range(0);
+
+    std::vector<float> values;
+    for (const auto& row : rows(64, columns))
+    {
+        for (const auto& feature : row)
+        {
+            values.push_back(feature ? *feature : std::numeric_limits<float>::quiet_NaN());
+        }
+    }
+
+    std::vector<uint32_t> shared;
+    std::vector<float> sharedValues;
+    for (uint32_t j = 0; j < columns; j += share)
+    {
+        shared.push_back(j);
+        sharedValues.push_back(values[j]);
+        for (size_t row = 0; row < 64; ++row)
+        {
+            values[row * columns + j] = values[j];
+        }
+    }
+    const XGBoostPredictor::DenseData data{values.data(), 64, columns};
+    std::vector<float> scores(data.rows);
+
+    for (auto _ : state)
+    {
+        if (specialize)
+        {
+            predictor.specialize(shared.data(), sharedValues.data(), shared.size()).predict(data, scores.data(), scores.size(), true);
+        }
+        else
+        {
+            predictor.predict(data, scores.data(), scores.size(), true);
+        }
+        benchmark::DoNotOptimize(scores.data());
+    }
+    state.SetItemsProcessed(state.iterations() * data.rows);
+}
+
+BENCHMARK_CAPTURE(RankQuery, Full, false)->Arg(1)->Arg(2)->Arg(4);
+BENCHMARK_CAPTURE(RankQuery, Specialized, true)->Arg(1)->Arg(2)->Arg(4);
+
+//------------------------------------------------------------------------------
+
+// load generator: state.range(0) clients submit rows one by one, each waiting for
+// its predictions, direct predict() vs batcher of max_batch state.range(1)
+// (max_wait 100 us), counters: latency percentiles and mean batch size
+void ConcurrentRows(benchmark::State& state, const bool batched)
+{
+    const auto predictor = std::make_shared<const XGBoostPredictor>("data/info.model.json");
+    const auto data = rows(1000, 240);
+    const size_t clients = state.range(0);
+    constexpr size_t REQUESTS = 200;    // per client and iteration
+
+    XGBoostPredictorBatcher::Options options;
+    options.max_batch = state.range(1);
+    options.max_wait = std::chrono::microseconds(100);
+    XGBoostPredictorBatcher batcher(predictor, options);
+
+    std::vector<uint64_t> latencies;
+    std::vector<std::vector<uint64_t>> clientLatencies(clients);
+
+    for (auto _ : state)
+    {
+        std::vector<std::thread> threads;
+        for (size_t client = 0; client < clients; ++client)
+        {
+            threads.emplace_back([&, client]()
+            {
+                for (size_t i = 0; i < REQUESTS; ++i)
+                {
+                    const auto& row = data[(client * REQUESTS + i) % data.size()];
+                    const auto start = std::chrono::steady_clock::now();
+                    if (batched)
+                    {
+                        benchmark::DoNotOptimize(batcher.submit(row).get());
+                    }
+                    else
+                    {
+                        benchmark::DoNotOptimize(predictor->predict(row));
+                    }
+                    clientLatencies[client].push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+                }
+            });
+        }
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * clients * REQUESTS);
+
+    for (const auto& client : clientLatencies)
+    {
+        latencies.insert(latencies.end(), client.begin(), client.end());
+    }
+    std::sort(latencies.begin(), latencies.end());
+    state.counters["p50_us"] = latencies[latencies.size() / 2] / 1000.0;
+    state.counters["p99_us"] = latencies[latencies.size() * 99 / 100] / 1000.0;
+
+    const auto stats = batcher.stats();
+    state.counters["batch"] = stats.batches ? static_cast<double>(stats.rows) / stats.batches : 0.0;
+}
+
+BENCHMARK_CAPTURE(ConcurrentRows, Direct, false)->Args({1, 1})->Args({16, 1})->UseRealTime();
+BENCHMARK_CAPTURE(ConcurrentRows, Batched, true)->Args({1, 16})->Args({16, 4})->Args({16, 16})->Args({16, 64})->UseRealTime();
+
+//------------------------------------------------------------------------------
+
+void PredictBatchThreads(benchmark::State& state)
+{
+    XGBoostPredictor::Options options;
+    options.executor = std::make_shared<ThreadPool>(state.range(0));
+    const XGBoostPredictor predictor("data/info.model.json", options);
+    const auto data = rows(10000, 240);
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(predictor.predict(data, true));
+    }
+    state.SetItemsProcessed(state.iterations() * data.size());
+}
+
+BENCHMARK(PredictBatchThreads)->DenseRange(1, std::max(1U, std::thread::hardware_concurrency()))->UseRealTime();
+
+//------------------------------------------------------------------------------
+
+void PredictMulticlass(benchmark::State& state, const bool matrix)
+{
+    const XGBoostPredictor predictor("data/multiclass.model.json");
+    const size_t columns = predictor.numFeatures();
+
+    std::vector<float> values;
+    for (const auto& row : rows(1024, columns))
+    {
+        for (const auto& feature : row)
+        {
+            values.push_back(feature ? *feature : std::numeric_limits<float>::quiet_NaN());
+        }
+    }
+    const XGBoostPredictor::DenseData data{values.data(), values.size() / columns, columns};
+
+    for (auto _ : state)
+    {
+        if (matrix)
+        {
+            benchmark::DoNotOptimize(predictor.predictMatrix(data));
+        }
+        else
+        {
+            for (size_t row = 0; row < data.rows; ++row)
+            {
+                benchmark::DoNotOptimize(predictor.predict(data.values + row * columns, columns));
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * data.rows);
+}
+
+BENCHMARK_CAPTURE(PredictMulticlass, Rows, false);
+BENCHMARK_CAPTURE(PredictMulticlass, Matrix, true);
+
+//------------------------------------------------------------------------------
+
+// synthetic models: small and large binary, multiclass
+const SyntheticModel SMALL{100, 6, 100, 1, 0.3f};
+const SyntheticModel LARGE{1000, 8, 500, 1, 0.3f};
+const SyntheticModel MULTICLASS{100, 6, 100, 5, 0.3f};
+
+//------------------------------------------------------------------------------
+
+// model load time, counters: nodes, model bytes and peak resident memory of loading
+void SyntheticLoad(benchmark::State& state, const SyntheticModel& model)
+{
+    const std::string file = syntheticModelFile(model);
+
+    size_t nodes = 0;
+    for (auto _ : state)
+    {
+        const XGBoostPredictor predictor(file);
+        nodes = predictor.model().nodes.size();
+    }
+
+    state.counters["nodes"] = nodes;
+    state.counters["model_bytes"] = nodes * sizeof(XGBoostPredictor::Node);
+    state.counters["load_peak_kb"] = loadPeakKB(file);
+    std::remove(file.c_str());
+}
+
+BENCHMARK_CAPTURE(SyntheticLoad, Small, SMALL)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(SyntheticLoad, Large, LARGE)->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(SyntheticLoad, Multiclass, MULTICLASS)->Unit(benchmark::kMillisecond);
+
+//------------------------------------------------------------------------------
+
+// single row latency of dense rows
+void SyntheticPredictRow(benchmark::State& state, const SyntheticModel& model)
+{
+    const std::string file = syntheticModelFile(model);
+    const XGBoostPredictor predictor(file);
+    std::remove(file.c_str());
+
+    const auto values = syntheticRows(model, 1000);
+    std::vector<float> predictions(predictor.numPredictors());
+
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        predictor.predict(values.data() + (i++ % 1000) * model.features, model.features, predictions.data(), predictions.size());
+        benchmark::DoNotOptimize(predictions.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_CAPTURE(SyntheticPredictRow, Small, SMALL);
+BENCHMARK_CAPTURE(SyntheticPredictRow, Large, LARGE);
+BENCHMARK_CAPTURE(SyntheticPredictRow, Multiclass, MULTICLASS);
+
+//------------------------------------------------------------------------------
+
+// batch throughput of 4096 dense rows on state.range(0) threads,
+// counters: time per row and rows per second per core
+void SyntheticPredictBatch(benchmark::State& state, const SyntheticModel& model)
+{
+    const size_t threads = state.range(0);
+    XGBoostPredictor::Options options;
+    if (threads > 1)
+    {
+        options.executor = std::make_shared<ThreadPool>(threads);
+    }
+
+    const std::string file = syntheticModelFile(model);
+    const XGBoostPredictor predictor(file, options);
+    std::remove(file.c_str());
+
+    const auto values = syntheticRows(model, 4096);
+    const XGBoostPredictor::DenseData data{values.data(), 4096, model.features};
+    std::vector<float> scores(data.rows * predictor.numPredictors());
+
+    for (auto _ : state)
+    {
+        predictor.predictMatrix(data, scores.data(), scores.size());
+        benchmark::DoNotOptimize(scores.data());
+    }
+
+    const double rows = static_cast<double>(state.iterations()) * data.rows;
+    state.SetItemsProcessed(rows);
+    state.counters["ns_per_row"] = benchmark::Counter(rows, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+    state.counters["rows_per_core"] = benchmark::Counter(rows / threads, benchmark::Counter::kIsRate);
+}
+
+BENCHMARK_CAPTURE(SyntheticPredictBatch, Small, SMALL)->Arg(1)->UseRealTime();
+BENCHMARK_CAPTURE(SyntheticPredictBatch, Large, LARGE)->DenseRange(1, std::max(1U, std::thread::hardware_concurrency()))->UseRealTime();
+BENCHMARK_CAPTURE(SyntheticPredictBatch, Multiclass, MULTICLASS)->Arg(1)->UseRealTime();
+
+//------------------------------------------------------------------------------
+
+void TransformSigmoid(benchmark::State& state)
+{
+    std::vector<float> margins(state.range(0));
+    for (size_t i = 0; i < margins.size(); ++i)
+    {
+        margins[i] = 0.01f * i - 5.0f;
+    }
+    std::vector<float> scores(margins.size());
+
+    for (auto _ : state)
+    {
+        std::copy(margins.begin(), margins.end(), scores.begin());
+        XGBoostPredictor::transformSigmoid(scores.data(), scores.size());
+        benchmark::DoNotOptimize(scores.data());
+    }
+    state.SetItemsProcessed(state.iterations() * scores.size());
+}
+
+BENCHMARK(TransformSigmoid)->Arg(1024);
+
+//------------------------------------------------------------------------------
+
+// softmax of 1024 rows of 3 classes as predictMatrix applies it, state.range(0): fast_transform
+void TransformSoftmax(benchmark::State& state)
+{
+    XGBoostPredictor::Options options;
+    options.fast_transform = state.range(0);
+    const XGBoostPredictor predictor("data/multiclass.model.json", options);
+
+    std::vector<float> margins(1024 * 3);
+    for (size_t i = 0; i < margins.size(); ++i)
+    {
+        margins[i] = 0.01f * i - 15.0f;
+    }
+    std::vector<float> scores(margins.size());
+
+    for (auto _ : state)
+    {
+        std::copy(margins.begin(), margins.end(), scores.begin());
+        predictor.transformMargins(scores.data(), scores.size(), 3);
+        benchmark::DoNotOptimize(scores.data());
+    }
+    state.SetItemsProcessed(state.iterations() * scores.size() / 3);
+}
+
+BENCHMARK(TransformSoftmax)->Arg(0)->Arg(1);
+
+//------------------------------------------------------------------------------
+
+} // namespaces
+
+BENCHMARK_MAIN();
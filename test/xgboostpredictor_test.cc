@@ -1,14 +1,908 @@
 #include <gmock/gmock.h>
 
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <set>
+#include <sstream>
+#include <thread>
+
 #include "xgboostpredictor.h"
+#include "xgboostpredictorholder.h"
+#include "xgboostpredictorbatcher.h"
+#include "xgboostcodegenerator.h"
+#include "info_model.h"
+
+
+// heap allocations of the test process, counted by replaced global operator new
+static std::atomic<size_t> allocations{0};
+
+void* operator new(const size_t size)
+{
+    ++allocations;
+    if (void* p = std::malloc(size ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+
+namespace xgboost::predictor
+{
+
+//------------------------------------------------------------------------------
+
+// test rows of columns features: feature j of row i is 0.9 * i - 14.58 + 3 * j,
+// missing if (i + j) % (2 + i % 3) == 0
+// values is the dense row-major copy, NaN value is missing feature
+struct TestRows
+{
+    TestRows(const size_t rows, const size_t columns)
+        :columns(columns)
+    {
+        for (size_t i = 0; i < rows; ++i)
+        {
+            data.emplace_back(columns);
+            for (size_t j = 0; j < columns; ++j)
+            {
+                if ((i + j) % (2 + i % 3))
+                {
+                    data.back()[j] = 0.9f * i - 14.58f + 3 * j;
+                }
+                values.push_back(data.back()[j] ? *data.back()[j] : std::numeric_limits<float>::quiet_NaN());
+            }
+        }
+    }
+
+    // dense row i
+    const float* row(const size_t i) const
+    {
+        return values.data() + i * columns;
+    }
+
+    XGBoostPredictor::DenseData dense() const
+    {
+        return XGBoostPredictor::DenseData{values.data(), data.size(), columns};
+    }
+
+    // set feature j of row i in both copies, empty value: missing
+    void set(const size_t i, const size_t j, const XGBoostPredictor::Data::value_type value)
+    {
+        data[i][j] = value;
+        values[i * columns + j] = value ? *value : std::numeric_limits<float>::quiet_NaN();
+    }
+
+    const size_t columns;
+    std::vector<XGBoostPredictor::Data> data;
+    std::vector<float> values;
+};
+
+//------------------------------------------------------------------------------
+
+TEST(XGBoostPredictor, Predict)
+{
+    XGBoostPredictor predictor("data/info.model.json");
+
+    XGBoostPredictor::Data data(240);
+    for (size_t i = 0; i < data.size(); i += 2)
+    {
+        data[i] = 2 * i - 14.58f;
+    }
+
+    const auto prediction = predictor.predict(data, true);
+    ASSERT_EQ(prediction.size(), 1U);
+    ASSERT_FLOAT_EQ(prediction[0], -1.6755048f);
+}
+
+//------------------------------------------------------------------------------
+
+TEST(XGBoostPredictor, Rank)
+{
+    XGBoostPredictor predictor("data/info.model.json"); // "binary:logistic"
+
+    std::vector<XGBoostPredictor::Data> candidates;
+    for (size_t i = 0; i < 2; ++i)
+    {
+        candidates.emplace_back(240);
+        auto& data = candidates.back();
+        for (size_t j = i; j < data.size(); j += 2)
+        {
+            data[j] = 2 * i - 14.58f + 3 * j;
+        }
+    }
+
+    auto scores = predictor.predict(candidates, false);
+    ASSERT_EQ(scores.size(), 2U);
+    ASSERT_FLOAT_EQ(scores[0], 0.15769163f);
+    ASSERT_FLOAT_EQ(scores[1], 0.18086274f);
+}
+
+//------------------------------------------------------------------------------
+
+TEST(XGBoostPredictor, PredictDense)
+{
+    XGBoostPredictor predictor("data/info.model.json");
+    ASSERT_EQ(predictor.numFeatures(), 255U);
+
+    XGBoostPredictor::Data data(240);
+    std::vector<float> dense(predictor.numFeatures(), std::numeric_limits<float>::quiet_NaN());
+    for (size_t i = 0; i < data.size(); i += 2)
+    {
+        data[i] = 2 * i - 14.58f;
+        dense[i] = *data[i];
+    }
+
+    const auto prediction = predictor.predict(dense.data(), dense.size(), true);
+    ASSERT_EQ(prediction.size(), 1U);
+    ASSERT_FLOAT_EQ(prediction[0], -1.6755048f);
+
+    // short data, missing trailing features
+    for (const size_t size : {0UL, 1UL, 17UL, 100UL, 240UL})
+    {
+        const XGBoostPredictor::Data shortData(data.begin(), data.begin() + size);
+        ASSERT_EQ(predictor.predict(dense.data(), size), predictor.predict(shortData));
+    }
+}
+
+//------------------------------------------------------------------------------
+
+TEST(XGBoostPredictor, RankBlocked)
+{
+    std::vector<XGBoostPredictor::Data> candidates;
+    for (size_t i = 0; i < 150; ++i)
+    {
+        candidates.emplace_back(240);
+        auto& data = candidates.back();
+        for (size_t j = i % 3; j < data.size(); j += 1 + i % 5)
+        {
+            data[j] = 0.7f * i - 14.58f + 3 * j;
+        }
+    }
+
+    for (const size_t rowBlock : {0UL, 1UL, 7UL, 64UL, 1000UL})
+    {
+        for (const size_t treeBlockBytes : {0UL, 1UL, 4096UL, 128 * 1024UL})
+        {
+            XGBoostPredictor::Options options;
+            options.row_block = rowBlock;
+            options.tree_block_bytes = treeBlockBytes;
+            XGBoostPredictor predictor("data/info.model.json", options);
+
+            const auto scores = predictor.predict(candidates, true);
+            ASSERT_EQ(scores.size(), candidates.size());
+            for (size_t i = 0; i < candidates.size(); ++i)
+            {
+                ASSERT_EQ(scores[i], predictor.predict(candidates[i], true)[0]);
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+TEST(XGBoostPredictor, RankDense)
+{
+    XGBoostPredictor predictor("data/info.model.json");
+    XGBoostPredictor::Options options;
+    options.simd = false;
+    XGBoostPredictor scalar("data/info.model.json", options);
+
+    for (const size_t columns : {predictor.numFeatures(), predictor.numFeatures() + 3, 100UL})
+    {
+        const TestRows rows(77, columns);
+        const auto& candidates = rows.data;
+        const auto dense = rows.dense();
+        ASSERT_EQ(predictor.predict(dense, true), predictor.predict(candidates, true));
+        ASSERT_EQ(scalar.predict(dense, true), predictor.predict(candidates, true));
+        ASSERT_EQ(predictor.predict(dense, false), predictor.predict(candidates, false));
+    }
+}
+
+//------------------------------------------------------------------------------
+
+TEST(XGBoostPredictor, QuickScorer)
+{
+    XGBoostPredictor predictor("data/info.model.json");
+    XGBoostPredictor::Options options;
+    options.engine = XGBoostPredictor::Engine::QUICKSCORER;
+    XGBoostPredictor quickScorer("data/info.model.json", options);
+
+    TestRows rows(50, predictor.numFeatures());
+    for (size_t i = 0; i < rows.data.size(); i += 7)
+    {
+        // engaged NaN goes to no child
+        for (size_t j = 0; j < rows.columns; j += 5)
+        {
+            rows.set(i, j, std::numeric_limits<float>::quiet_NaN());
+        }
+    }
+
+    for (size_t i = 0; i < rows.data.size(); ++i)
+    {
+        ASSERT_EQ(quickScorer.predict(rows.data[i], true), predictor.predict(rows.data[i], true));
+        ASSERT_EQ(quickScorer.predict(rows.row(i), rows.columns, true), predictor.predict(rows.row(i), rows.columns, true));
+        ASSERT_EQ(quickScorer.predict(rows.row(i), 100, true), predictor.predict(rows.row(i), 100, true));
+    }
+
+    ASSERT_EQ(quickScorer.predict(rows.data, false), predictor.predict(rows.data, false));
+    ASSERT_EQ(quickScorer.predict(rows.dense(), false), predictor.predict(rows.dense(), false));
+}
+
+//------------------------------------------------------------------------------
+
+TEST(XGBoostPredictor, Quantized)
+{
+    XGBoostPredictor::Options options;
+    options.engine = XGBoostPredictor::Engine::QUANTIZED;
+
+    for (const char* file : {"data/info.model.json", "data/multiclass.model.json"})
+    {
+        const XGBoostPredictor predictor(file);
+        const XGBoostPredictor quantized(file, options);
+        const size_t features = predictor.numFeatures();
+
+        // values at, just below and just above model thresholds
+        std::vector<std::vector<float>> thresholds(features);
+        for (const auto& node : predictor.model().nodes)
+        {
+            thresholds[node.feature()].push_back(node.value);
+        }
+
+        TestRows rows(60, features);
+        for (size_t i = 0; i < rows.data.size(); ++i)
+        {
+            for (size_t j = 0; j < features; ++j)
+            {
+                if (!rows.data[i][j] || thresholds[j].empty())
+                {
+                    rows.set(i, j, {});
+                    continue;
+                }
+                const float threshold = thresholds[j][(i * 7 + j) % thresholds[j].size()];
+                // engaged NaN compares false
+                const bool nan = i % 11 == 0 && j % 5 == 0;
+                rows.set(i, j, nan ? std::numeric_limits<float>::quiet_NaN() : i % 3 == 0 ? threshold : std::nextafter(threshold, i % 3 == 1 ? -INFINITY : INFINITY));
+            }
+
+            ASSERT_EQ(quantized.predict(rows.data[i], true), predictor.predict(rows.data[i], true));
+            ASSERT_EQ(quantized.predict(rows.row(i), features, true), predictor.predict(rows.row(i), features, true));
+            ASSERT_EQ(quantized.predict(rows.row(i), features / 2, true), predictor.predict(rows.row(i), features / 2, true));
+        }
+
+        ASSERT_EQ(quantized.predictMatrix(rows.data), predictor.predictMatrix(rows.data));
+        ASSERT_EQ(quantized.predictMatrix(rows.dense()), predictor.predictMatrix(rows.dense()));
+    }
+
+    // feature with more than 253 thresholds has uint16 bins
+    const size_t depth = 300;
+    std::string defaultLeft, left, right, indices, conditions;
+    for (size_t i = 0; i < 2 * depth + 1; ++i)
+    {
+        const bool leaf = i % 2 == 1 || i == 2 * depth;
+        const char* separator = i ? ", " : "";
+        defaultLeft += separator + std::string(i % 4 ? "false" : "true");
+        left += separator + std::to_string(leaf ? -1 : static_cast<long>(i + 1));
+        right += separator + std::to_string(leaf ? -1 : static_cast<long>(i + 2));
+        indices += separator + std::string("0");
+        conditions += separator + std::to_string(leaf ? 0.5f * i : 1000.0f - i);
+    }
+
+    const std::string file = testing::TempDir() + "wide.model.json";
+    std::ofstream(file) << R"({"learner": {"gradient_booster": {"model": {"trees": [{"default_left": [)" << defaultLeft <<
+            R"(], "left_children": [)" << left << R"(], "right_children": [)" << right << R"(], "split_indices": [)" << indices <<
+            R"(], "split_conditions": [)" << conditions << R"(]}], "tree_info": [0]}},
+            "learner_model_param": {"base_score": "0"}, "objective": {"name": "reg:squarederror"}}})";
+
+    const XGBoostPredictor wide(file);
+    const XGBoostPredictor wideQuantized(file, options);
+    for (float value = 350.0f; value < 1001.0f; value += 0.5f)
+    {
+        ASSERT_EQ(wideQuantized.predict(XGBoostPredictor::Data{value}, true), wide.predict(XGBoostPredictor::Data{value}, true));
+    }
+    ASSERT_EQ(wideQuantized.predict(XGBoostPredictor::Data{}, true), wide.predict(XGBoostPredictor::Data{}, true));
+    std::remove(file.c_str());
+}
+
+//------------------------------------------------------------------------------
+
+TEST(XGBoostPredictor, Relayout)
+{
+    XGBoostPredictor::Options counting;
+    counting.count_hits = true;
+    XGBoostPredictor::Options cover;
+    cover.layout = XGBoostPredictor::Layout::COVER;
+
+    for (const char* file : {"data/info.model.json", "data/multiclass.model.json"})
+    {
+        const XGBoostPredictor predictor(file);
+        const XGBoostPredictor counted(file, counting);
+        const size_t features = predictor.numFeatures();
+
+        const TestRows rows(100, features);
+        const auto& candidates = rows.data;
+        for (const auto& data : candidates)
+        {
+            ASSERT_EQ(counted.predict(data, true), predictor.predict(data, true));
+        }
+
+        const auto dense = rows.dense();
+        ASSERT_EQ(counted.predictMatrix(dense, true), predictor.predictMatrix(dense, true));
+
+        // each prediction passes every tree root once
+        const auto hits = counted.hitCounts();
+        ASSERT_EQ(hits.size(), predictor.model().nodes.size() * 2);
+        for (const auto& tree : counted.model().trees)
+        {
+            ASSERT_EQ(hits[tree.root * 2] + hits[tree.root * 2 + 1], 2 * candidates.size());
+        }
+
+        const XGBoostPredictor relaid(counted, hits, XGBoostPredictor::Options());
+        ASSERT_EQ(relaid.predictMatrix(candidates, true), predictor.predictMatrix(candidates, true));
+        ASSERT_EQ(relaid.predictMatrix(dense, true), predictor.predictMatrix(dense, true));
+
+        // more often taken decision child follows its parent (counted again on new layout)
+        const XGBoostPredictor recounted(counted, hits, counting);
+        recounted.predictMatrix(dense, true);
+        const auto recounts = recounted.hitCounts();
+        const auto& nodes = relaid.model().nodes;
+        ASSERT_EQ(std::memcmp(recounted.model().nodes.data(), nodes.data(), nodes.size() * sizeof(XGBoostPredictor::Node)), 0);
+        for (size_t i = 0; i < nodes.size(); ++i)
+        {
+            const auto& node = nodes[i];
+            if (!node.isLeaf(0) && !node.isLeaf(1))
+            {
+                ASSERT_EQ(node.children[recounts[i * 2 + 1] > recounts[i * 2] ? 1 : 0].offset, i + 1);
+            }
+        }
+
+        // layout is kept by binary model file
+        const std::string binary = testing::TempDir() + "relaid.model.bin";
+        relaid.save(binary);
+        const XGBoostPredictor loaded(binary);
+        ASSERT_EQ(std::memcmp(loaded.model().nodes.data(), nodes.data(), nodes.size() * sizeof(XGBoostPredictor::Node)), 0);
+        ASSERT_EQ(loaded.predictMatrix(dense, true), predictor.predictMatrix(dense, true));
+        std::remove(binary.c_str());
+
+        const XGBoostPredictor covered(file, cover);
+        ASSERT_EQ(covered.predictMatrix(dense, true), predictor.predictMatrix(dense, true));
+
+        counted.resetHitCounts();
+        ASSERT_EQ(counted.hitCounts(), std::vector<uint64_t>(hits.size()));
+        ASSERT_TRUE(predictor.hitCounts().empty());
+        ASSERT_THROW(XGBoostPredictor(counted, std::vector<uint64_t>(3), XGBoostPredictor::Options()), std::runtime_error);
+    }
+
+    // cover layout differs from yes child first preorder
+    const XGBoostPredictor predictor("data/info.model.json");
+    const XGBoostPredictor covered("data/info.model.json", cover);
+    const auto& nodes = predictor.model().nodes;
+    ASSERT_EQ(covered.model().nodes.size(), nodes.size());
+    ASSERT_NE(std::memcmp(covered.model().nodes.data(), nodes.data(), nodes.size() * sizeof(XGBoostPredictor::Node)), 0);
+
+    // model without sum_hessian keeps yes child first
+    const XGBoostPredictor multiclass("data/multiclass.model.ubj");
+    const XGBoostPredictor multiclassCovered("data/multiclass.model.ubj", cover);
+    const auto& multiclassNodes = multiclass.model().nodes;
+    ASSERT_EQ(std::memcmp(multiclassCovered.model().nodes.data(), multiclassNodes.data(), multiclassNodes.size() * sizeof(XGBoostPredictor::Node)), 0);
+}
+
+//------------------------------------------------------------------------------
+
+TEST(XGBoostPredictor, Session)
+{
+    for (const char* file : {"data/info.model.json", "data/multiclass.model.json"})
+    {
+        const XGBoostPredictor predictor(file);
+        const size_t features = predictor.numFeatures();
+
+        // trees splitting on each feature
+        const auto& model = predictor.model();
+        std::vector<std::set<size_t>> featureTrees(features);
+        for (size_t tree = 0; tree < model.trees.size(); ++tree)
+        {
+            const size_t end = tree + 1 < model.trees.size() ? model.trees[tree + 1].root : model.nodes.size();
+            for (size_t i = model.trees[tree].root; i < end; ++i)
+            {
+                featureTrees[model.nodes[i].feature()].insert(tree);
+            }
+        }
+
+        std::vector<float> row(features, std::numeric_limits<float>::quiet_NaN());
+        for (size_t j = 0; j < features; j += 2)
+        {
+            row[j] = 2 * j - 14.58f;
+        }
+
+        XGBoostPredictor::Session session(predictor, row.data(), row.size());
+        ASSERT_EQ(session.predict(), predictor.predict(row.data(), row.size()));
+        ASSERT_EQ(session.predict(true), predictor.predict(row.data(), row.size(), true));
+
+        for (size_t i = 0; i < 200; ++i)
+        {
+            const uint32_t feature = (i * 37) % features;
+            const float value = i % 7 == 0 ? std::numeric_limits<float>::quiet_NaN() : 0.9f * i - 14.58f + 3 * feature;
+            const bool changed = !(row[feature] == value || (std::isnan(row[feature]) && std::isnan(value)));
+            row[feature] = value;
+
+            // only trees splitting on a changed feature are traversed
+            ASSERT_EQ(session.update(feature, value), changed ? featureTrees[feature].size() : 0U);
+            ASSERT_EQ(session.predict(true), predictor.predict(row.data(), row.size(), true));
+        }
+
+        // trees of several changed features are traversed once
+        const uint32_t changed[] = {0, 1, 2, 3};
+        const float values[] = {100.0f, 200.0f, 300.0f, 400.0f};
+        std::set<size_t> trees;
+        for (const uint32_t feature : changed)
+        {
+            row[feature] = values[feature];
+            trees.insert(featureTrees[feature].begin(), featureTrees[feature].end());
+        }
+        ASSERT_EQ(session.update(changed, values, 4), trees.size());
+        ASSERT_EQ(session.predict(), predictor.predict(row.data(), row.size()));
+        ASSERT_EQ(session.row().size(), row.size());
+        ASSERT_EQ(std::memcmp(session.row().data(), row.data(), row.size() * sizeof(float)), 0);
+
+        // features not used by the model
+        ASSERT_EQ(session.update(features + 5, 1.0f), 0U);
+
+        // row shorter than numFeatures() and reset
+        session.reset(row.data(), features / 2);
+        ASSERT_EQ(session.predict(), predictor.predict(row.data(), features / 2));
+    }
+}
+
+//------------------------------------------------------------------------------
+
+TEST(XGBoostPredictor, Specialize)
+{
+    for (const char* file : {"data/info.model.json", "data/multiclass.model.json"})
+    {
+        const XGBoostPredictor predictor(file);
+        const size_t features = predictor.numFeatures();
+
+        // query features: every third feature, some missing
+        std::vector<uint32_t> shared;
+        std::vector<float> sharedValues;
+        for (uint32_t j = 0; j < features; j += 3)
+        {
+            shared.push_back(j);
+            sharedValues.push_back(j % 4 == 0 ? std::numeric_limits<float>::quiet_NaN() : 1.7f * j - 20.0f);
+        }
+
+        const auto residual = predictor.specialize(shared.data(), sharedValues.data(), shared.size());
+        ASSERT_EQ(residual.numPredictors(), predictor.numPredictors());
+        ASSERT_EQ(residual.model().trees.size(), predictor.model().trees.size());
+        ASSERT_LT(residual.model().nodes.size(), predictor.model().nodes.size());
+
+        // candidates: full rows with query values, document rows with other values at query features
+        TestRows candidates(50, features);
+        TestRows documents(50, features);
+        for (size_t i = 0; i < candidates.data.size(); ++i)
+        {
+            for (size_t j = 0; j < features; j += 3)
+            {
+                const float value = sharedValues[j / 3];
+                candidates.set(i, j, std::isnan(value) ? XGBoostPredictor::Data::value_type() : value);
+                documents.set(i, j, 1000.0f - i);
+            }
+        }
+
+        const auto expected = predictor.predictMatrix(candidates.data, true);
+        ASSERT_EQ(residual.predictMatrix(candidates.data, true), expected);
+        ASSERT_EQ(residual.predictMatrix(documents.data, true), expected);
+        ASSERT_EQ(residual.predictMatrix(documents.dense(), true), expected);
+
+        // all features shared: every tree is a single leaf
+        std::vector<uint32_t> all(features);
+        std::iota(all.begin(), all.end(), 0);
+        const auto leaves = predictor.specialize(all.data(), candidates.row(7), features);
+        ASSERT_EQ(leaves.model().nodes.size(), leaves.model().trees.size());
+        ASSERT_EQ(leaves.predict(XGBoostPredictor::Data{}, true), predictor.predict(candidates.row(7), features, true));
+
+        // nothing shared: same model
+        const auto same = predictor.specialize(nullptr, nullptr, 0);
+        ASSERT_EQ(same.model().nodes.size(), predictor.model().nodes.size());
+        ASSERT_EQ(std::memcmp(same.model().nodes.data(), predictor.model().nodes.data(), predictor.model().nodes.size() * sizeof(XGBoostPredictor::Node)), 0);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+TEST(XGBoostPredictor, PredictBounded)
+{
+    const XGBoostPredictor predictor("data/info.model.json");
+    const size_t features = predictor.numFeatures();
+    const uint32_t trees = predictor.model().trees.size();
+
+    std::vector<XGBoostPredictor::Data> candidates;
+    for (size_t i = 0; i < 200; ++i)
+    {
+        candidates.emplace_back(features);
+        auto& data = candidates.back();
+        for (size_t j = 0; j < features; ++j)
+        {
+            if ((i * 7 + j) % (2 + i % 5))
+            {
+                data[j] = 0.9f * i - 14.58f + 3 * j;
+            }
+        }
+    }
+
+    uint32_t evaluated = 0;
+    size_t decisions = 0;
+    for (const float cutoff : {-4.0f, -2.0f, -1.5f, -1.0f, 0.0f, 1.0f})
+    {
+        for (const auto& data : candidates)
+        {
+            const float margin = predictor.predict(data, true)[0];
+
+            std::vector<float> dense(features, std::numeric_limits<float>::quiet_NaN());
+            for (size_t j = 0; j < features; ++j)
+            {
+                dense[j] = data[j] ? *data[j] : dense[j];
+            }
+
+            for (const bool exitAbove : {true, false})
+            {
+                for (const auto& result : {predictor.predictBounded(data, cutoff, exitAbove), predictor.predictBounded(dense.data(), dense.size(), cutoff, exitAbove)})
+                {
+                    ASSERT_EQ(result.above, margin >= cutoff);
+                    ASSERT_LE(result.lower, margin);
+                    ASSERT_GE(result.upper, margin);
+                    ASSERT_LE(result.trees, trees);
+                    if (result.trees == trees)
+                    {
+                        ASSERT_EQ(result.lower, margin);
+                        ASSERT_EQ(result.upper, margin);
+                    }
+                    if (!exitAbove && result.above)
+                    {
+                        ASSERT_EQ(result.trees, trees);
+                    }
+                    evaluated += result.trees;
+                    ++decisions;
+                }
+            }
+        }
+
+        // cutoff equal to margin is reached
+        const float margin = predictor.predict(candidates[3], true)[0];
+        ASSERT_TRUE(predictor.predictBounded(candidates[3], margin).above);
+        ASSERT_FALSE(predictor.predictBounded(candidates[3], std::nextafter(margin, INFINITY)).above);
+    }
+
+    // bounds skip trees of clear decisions
+    ASSERT_LT(evaluated, decisions * trees);
+
+    const XGBoostPredictor multiclass("data/multiclass.model.json");
+    ASSERT_THROW(multiclass.predictBounded(XGBoostPredictor::Data{}, 0.0f), std::runtime_error);
+}
+
+//------------------------------------------------------------------------------
+
+TEST(XGBoostPredictor, Compact)
+{
+    const std::string file = testing::TempDir() + "compact.model.json";
+
+    // tree 0: split on feature 40 with equal leaves, tree 1: subtree on feature 7 of tree 0,
+    // tree 2: zero leaves only, tree 3: single leaf, tree 4: copy of tree 0
+    const std::string split7 = R"("left_children": [1, 3, -1, -1, -1], "right_children": [2, 4, -1, -1, -1])";
+    const std::string tree0 = R"({"default_left": [true, false, false, false, false, false, false],
+        "left_children": [1, 3, 5, -1, -1, -1, -1], "right_children": [2, 4, 6, -1, -1, -1, -1],
+        "split_indices": [3, 7, 40, 0, 0, 0, 0], "split_conditions": [1, 2, 3, 0.5, -0.5, 0.25, 0.25]})";
+    std::ofstream(file) << R"({"learner": {"gradient_booster": {"model": {"trees": [)" << tree0 <<
+        R"(, {"default_left": [false, false, false, false, false], )" << split7 <<
+        R"(, "split_indices": [40, 7, 0, 0, 0], "split_conditions": [5, 2, 1, 0.5, -0.5]})" <<
+        R"(, {"default_left": [false, false, false, false, false], )" << split7 <<
+        R"(, "split_indices": [3, 7, 0, 0, 0], "split_conditions": [0, 1, 0, 0, 0]})" <<
+        R"(, {"default_left": [false], "left_children": [-1], "right_children": [-1], "split_indices": [0], "split_conditions": [0.125]})" <<
+        R"(, )" << tree0 << R"(], "tree_info": [0, 0, 0, 0, 0]}},
+        "learner_model_param": {"base_score": "5E-1"}, "objective": {"name": "binary:logistic"}}})";
+
+    XGBoostPredictor::Options options;
+    options.compact = true;
+    XGBoostPredictor::Options remapping = options;
+    remapping.remap_features = true;
+
+    const XGBoostPredictor predictor(file);
+    const XGBoostPredictor compacted(file, options);
+    const XGBoostPredictor remapped(file, remapping);
+    XGBoostPredictor::Options remapOnly;
+    remapOnly.remap_features = true;
+    const XGBoostPredictor remappedOnly(file, remapOnly);
+    std::remove(file.c_str());
+
+    const auto& stats = remapped.compactionStats();
+    ASSERT_EQ(stats.nodes_before, 11U);
+    ASSERT_EQ(stats.nodes_after, 5U);
+    ASSERT_EQ(stats.trees_before, 5U);
+    ASSERT_EQ(stats.trees_after, 4U);
+    ASSERT_EQ(stats.redundant_splits, 4U);
+    ASSERT_EQ(stats.zero_trees, 1U);
+    ASSERT_EQ(stats.shared_subtrees, 2U);
+    ASSERT_EQ(stats.features_before, 41U);
+    ASSERT_EQ(stats.features_after, 3U);
+    ASSERT_LT(stats.bytes_after, stats.bytes_before);
+    ASSERT_EQ(compacted.numFeatures(), 41U);
+    ASSERT_EQ(predictor.compactionStats().nodes_before, 0U);
+
+    const std::vector<uint32_t> features(remapped.model().features.begin(), remapped.model().features.end());
+    ASSERT_EQ(features, (std::vector<uint32_t>{3, 7, 40}));
+
+    // remapping implies compaction
+    ASSERT_EQ(remappedOnly.compactionStats().nodes_after, 5U);
+    ASSERT_EQ(remappedOnly.numFeatures(), 3U);
+
+    std::vector<XGBoostPredictor::Data> candidates;
+    for (const float value : {-1.0f, 0.5f, 1.5f, 2.5f, 4.0f, 6.0f, NAN})
+    {
+        candidates.emplace_back(41);
+        auto& data = candidates.back();
+        if (!std::isnan(value))
+        {
+            data[3] = value;
+            data[7] = 3.0f - value;
+            data[40] = 2.0f * value;
+        }
+
+        ASSERT_EQ(compacted.predict(data, true), predictor.predict(data, true));
+        ASSERT_EQ(remapped.predict(remapped.remap(data), true), predictor.predict(data, true));
+
+        std::vector<float> row(41), compactRow(3);
+        for (size_t i = 0; i < row.size(); ++i)
+        {
+            row[i] = data[i] ? *data[i] : std::numeric_limits<float>::quiet_NaN();
+        }
+        remapped.remap(row.data(), row.size(), compactRow.data(), compactRow.size());
+        ASSERT_EQ(remapped.predict(compactRow.data(), compactRow.size()), predictor.predict(data));
+    }
+    ASSERT_EQ(compacted.predictMatrix(candidates, true), predictor.predictMatrix(candidates, true));
+
+    // shared subtrees survive relayout and binary model files keep the feature table
+    XGBoostPredictor::Options counting = remapping;
+    counting.count_hits = true;
+    const XGBoostPredictor counted(remapped, std::vector<uint64_t>(remapped.model().nodes.size() * 2), counting);
+    for (const auto& data : candidates)
+    {
+        counted.predict(remapped.remap(data));
+    }
+    const XGBoostPredictor relaid(counted, counted.hitCounts(), XGBoostPredictor::Options());
+    ASSERT_EQ(relaid.model().nodes.size(), 5U);
+
+    const std::string binaryFile = testing::TempDir() + "compact.model.bin";
+    relaid.save(binaryFile);
+    const XGBoostPredictor binary(binaryFile);
+    std::remove(binaryFile.c_str());
+    ASSERT_EQ(std::vector<uint32_t>(binary.model().features.begin(), binary.model().features.end()), features);
+    for (const auto& data : candidates)
+    {
+        ASSERT_EQ(binary.predict(binary.remap(data), true), predictor.predict(data, true));
+    }
+
+    // training output: no redundant nodes, unused features are remapped
+    for (const char* model : {"data/info.model.json", "data/multiclass.model.json"})
+    {
+        const XGBoostPredictor full(model);
+        const XGBoostPredictor compact(model, remapping);
+        ASSERT_LE(compact.numFeatures(), full.numFeatures());
+
+        for (const auto& data : TestRows(50, full.numFeatures()).data)
+        {
+            ASSERT_EQ(compact.predict(compact.remap(data), true), full.predict(data, true));
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+TEST(XGBoostPredictor, Profile)
+{
+    XGBoostPredictor::Options options;
+    options.profile = true;
+    options.profile_sample = 1;
+    const XGBoostPredictor predictor("data/info.model.json");
+    const XGBoostPredictor profiled("data/info.model.json", options);
+    ASSERT_TRUE(predictor.profile().rows.empty());
+
+    const TestRows rows(50, 240);
+    const auto& candidates = rows.data;
+
+    // single rows, dense rows and batch on concurrent threads
+    std::vector<std::thread> threads;
+    for (size_t thread = 0; thread < 3; ++thread)
+    {
+        threads.emplace_back([&, thread]()
+        {
+            for (size_t i = 0; i < candidates.size(); ++i)
+            {
+                if (thread == 0)
+                {
+                    ASSERT_EQ(profiled.predict(candidates[i]), predictor.predict(candidates[i]));
+                }
+                else if (thread == 1)
+                {
+                    ASSERT_EQ(profiled.predict(rows.row(i), 240), predictor.predict(rows.row(i), 240));
+                }
+            }
+            if (thread == 2)
+            {
+                ASSERT_EQ(profiled.predict(candidates, true), predictor.predict(candidates, true));
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    const auto profile = profiled.profile();
+    const size_t trees = predictor.model().trees.size();
+    ASSERT_EQ(profile.rows, std::vector<uint64_t>{3 * candidates.size()});
+    ASSERT_EQ(std::accumulate(profile.latency.begin(), profile.latency.end(), uint64_t(0)), 2 * candidates.size() + 1);
+    ASSERT_EQ(profile.tree_nodes.size(), trees);
+
+    // every row visits at least one node of every tree, and every visit decides on a feature
+    uint64_t nodes = 0;
+    for (size_t i = 0; i < trees; ++i)
+    {
+        ASSERT_GE(profile.tree_nodes[i], 3 * candidates.size());
+        ASSERT_GT(profile.tree_ns[i], 0U);
+        nodes += profile.tree_nodes[i];
+    }
+    ASSERT_EQ(std::accumulate(profile.feature_splits.begin(), profile.feature_splits.end(), uint64_t(0)), nodes);
+
+    uint64_t missing = 0;
+    for (size_t feature = 0; feature < profile.feature_splits.size(); ++feature)
+    {
+        ASSERT_LE(profile.feature_missing[feature], profile.feature_splits[feature]);
+        missing += profile.feature_missing[feature];
+    }
+    ASSERT_GT(missing, 0U);
+
+    std::ostringstream json;
+    XGBoostPredictor::writeProfile(profile, json);
+    ASSERT_EQ(json.str().find("{\"latency\": ["), 0U);
+    ASSERT_NE(json.str().find("\"feature_missing\": ["), std::string::npos);
+
+    // latency only: configured engine and batch paths run, batch call is one latency sample
+    options.profile_sample = 0;
+    options.engine = XGBoostPredictor::Engine::QUICKSCORER;
+    const XGBoostPredictor latency("data/info.model.json", options);
+    ASSERT_EQ(latency.predict(candidates.front()), predictor.predict(candidates.front()));
+    ASSERT_EQ(latency.predict(rows.dense()), predictor.predict(candidates));
+    const auto latencyProfile = latency.profile();
+    ASSERT_EQ(std::accumulate(latencyProfile.latency.begin(), latencyProfile.latency.end(), uint64_t(0)), 2U);
+    ASSERT_EQ(latencyProfile.rows, std::vector<uint64_t>{0});
+    ASSERT_EQ(std::accumulate(latencyProfile.tree_nodes.begin(), latencyProfile.tree_nodes.end(), uint64_t(0)), 0U);
+
+    // sampled traces without latency: every 7th row of the thread
+    options.profile = false;
+    options.profile_sample = 7;
+    options.engine = XGBoostPredictor::Engine::TREE;
+    const XGBoostPredictor sampled("data/info.model.json", options);
+    ASSERT_EQ(sampled.predict(rows.dense()), predictor.predict(candidates));
+    const auto sampledProfile = sampled.profile();
+    ASSERT_EQ(std::accumulate(sampledProfile.latency.begin(), sampledProfile.latency.end(), uint64_t(0)), 0U);
+    ASSERT_EQ(sampledProfile.rows, std::vector<uint64_t>{candidates.size() / 7});
+    ASSERT_GE(sampledProfile.tree_nodes.front(), candidates.size() / 7);
+}
+
+//------------------------------------------------------------------------------
+
+TEST(XGBoostPredictor, CodeGenerator)
+{
+    XGBoostPredictor predictor("data/info.model.json");
+    const test::InfoModel compiled; // generated from data/info.model.json
+
+    ASSERT_EQ(compiled.numFeatures(), predictor.numFeatures());
+    ASSERT_EQ(compiled.transformation, XGBoostPredictor::Transformation::SIGMOID);
+
+    const TestRows rows(50, predictor.numFeatures());
+    const auto& candidates = rows.data;
+    for (size_t i = 0; i < candidates.size(); ++i)
+    {
+        ASSERT_EQ(compiled.predict(candidates[i], true), predictor.predict(candidates[i], true));
+        ASSERT_EQ(compiled.predict(candidates[i], false), predictor.predict(candidates[i], false));
+        ASSERT_EQ(compiled.predict(rows.row(i), rows.columns, true), predictor.predict(rows.row(i), rows.columns, true));
+        ASSERT_EQ(compiled.predict(rows.row(i), 100, true), predictor.predict(rows.row(i), 100, true));
+    }
+
+    ASSERT_EQ(compiled.predict(candidates, false), predictor.predict(candidates, false));
+    ASSERT_EQ(compiled.remap(candidates[1]), candidates[1]);
+
+    // remapped features: feature table and remap are generated
+    XGBoostPredictor::Options options;
+    options.remap_features = true;
+    std::ostringstream code;
+    XGBoostCodeGenerator::generate(XGBoostPredictor("data/info.model.json", options), "Remapped", "", code);
+    ASSERT_NE(code.str().find("static constexpr uint32_t features[218] = {"), std::string::npos);
+    ASSERT_NE(code.str().find("return 218;"), std::string::npos);
+    ASSERT_NE(code.str().find("result[i] = data[features[i]];"), std::string::npos);
+}
+
+//------------------------------------------------------------------------------
+
+TEST(XGBoostPredictor, RankParallel)
+{
+    XGBoostPredictor predictor("data/info.model.json");
+
+    XGBoostPredictor::Options options;
+    options.executor = std::make_shared<ThreadPool>(4);
+    options.row_block = 16;
+    options.parallel_rows = 100;
+    XGBoostPredictor parallel("data/info.model.json", options);
+
+    std::vector<XGBoostPredictor::Data> candidates;
+    std::vector<float> values;
+    std::vector<size_t> offsets{0};
+    std::vector<uint32_t> indices;
+    for (size_t i = 0; i < 1000; ++i)
+    {
+        candidates.emplace_back(predictor.numFeatures());
+        auto& data = candidates.back();
+        for (size_t j = i % 3; j < data.size(); j += 1 + i % 4)
+        {
+            data[j] = 0.7f * i - 14.58f + 3 * j;
+            indices.push_back(j);
+        }
+        for (const auto& value : data)
+        {
+            values.push_back(value ? *value : std::numeric_limits<float>::quiet_NaN());
+        }
+        offsets.push_back(indices.size());
+    }
+    std::vector<float> csrValues;
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        const size_t row = std::upper_bound(offsets.begin(), offsets.end(), i) - offsets.begin() - 1;
+        csrValues.push_back(*candidates[row][indices[i]]);
+    }
 
+    const XGBoostPredictor::DenseData dense{values.data(), candidates.size(), predictor.numFeatures()};
+    const XGBoostPredictor::CSRData csr{offsets.data(), indices.data(), csrValues.data(), candidates.size()};
+    const auto expected = predictor.predict(candidates, true);
 
-namespace xgboost::predictor
-{
+    // concurrent callers share the pool
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < 3; ++i)
+    {
+        threads.emplace_back([&]()
+        {
+            for (size_t j = 0; j < 5; ++j)
+            {
+                EXPECT_EQ(parallel.predict(candidates, true), expected);
+                EXPECT_EQ(parallel.predict(dense, true), expected);
+                EXPECT_EQ(parallel.predict(csr, true), expected);
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    // small batch
+    const std::vector<XGBoostPredictor::Data> small(candidates.begin(), candidates.begin() + 10);
+    ASSERT_EQ(parallel.predict(small, false), predictor.predict(small, false));
+}
 
 //------------------------------------------------------------------------------
 
-TEST(XGBoostPredictor, Predict)
+TEST(XGBoostPredictor, PredictTreeParallel)
 {
     XGBoostPredictor predictor("data/info.model.json");
 
@@ -17,33 +911,110 @@ TEST(XGBoostPredictor, Predict)
     {
         data[i] = 2 * i - 14.58f;
     }
+    std::vector<float> dense(predictor.numFeatures(), std::numeric_limits<float>::quiet_NaN());
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+        dense[i] = data[i] ? *data[i] : dense[i];
+    }
 
-    const auto prediction = predictor.predict(data, true);
-    ASSERT_EQ(prediction.size(), 1U);
-    ASSERT_FLOAT_EQ(prediction[0], -1.6755048f);
+    std::vector<float> results;
+    for (const size_t threads : {1UL, 2UL, 4UL})
+    {
+        XGBoostPredictor::Options options;
+        options.executor = std::make_shared<ThreadPool>(threads, true, std::chrono::microseconds(100));
+        options.parallel_trees = 100;
+        options.tree_chunks = 3;
+        XGBoostPredictor parallel("data/info.model.json", options);
+
+        for (size_t i = 0; i < 10; ++i)
+        {
+            const auto prediction = parallel.predict(data, true);
+            ASSERT_EQ(prediction.size(), 1U);
+            ASSERT_FLOAT_EQ(prediction[0], -1.6755048f);
+            ASSERT_EQ(parallel.predict(dense.data(), dense.size(), true), prediction);
+            results.push_back(prediction[0]);
+        }
+
+        // same chunks, same result regardless of threads
+        ASSERT_EQ(results.front(), results.back());
+
+        const auto stats = parallel.treeParallelStats();
+        ASSERT_EQ(stats.calls, 20U);
+        ASSERT_GE(stats.wall_ns, stats.critical_ns);
+        ASSERT_GE(stats.work_ns, stats.critical_ns);
+    }
+
+    // below tree threshold
+    XGBoostPredictor::Options options;
+    options.executor = std::make_shared<ThreadPool>(2);
+    options.parallel_trees = 1000;
+    XGBoostPredictor sequential("data/info.model.json", options);
+    ASSERT_EQ(sequential.predict(data, true), predictor.predict(data, true));
+    ASSERT_EQ(sequential.treeParallelStats().calls, 0U);
 }
 
 //------------------------------------------------------------------------------
 
-TEST(XGBoostPredictor, Rank)
+TEST(ThreadPool, ParallelFor)
 {
-    XGBoostPredictor predictor("data/info.model.json"); // "binary:logistic"
+    ThreadPool pool(3);
+    ASSERT_EQ(pool.concurrency(), 3U);
+
+    std::vector<std::atomic<int>> counts(1000);
+    pool.parallelFor(counts.size(), [&counts](const size_t i)
+    {
+        ++counts[i];
+    });
+    for (const auto& count : counts)
+    {
+        ASSERT_EQ(count, 1);
+    }
+
+    pool.parallelFor(0, [](const size_t)
+    {
+        throw std::runtime_error("no task expected");
+    });
+
+    ASSERT_THROW(pool.parallelFor(100, [](const size_t i)
+    {
+        if (i == 42)
+        {
+            throw std::runtime_error("task failed");
+        }
+    }), std::runtime_error);
+}
+
+//------------------------------------------------------------------------------
+
+TEST(XGBoostPredictor, RankCSR)
+{
+    XGBoostPredictor predictor("data/info.model.json");
 
     std::vector<XGBoostPredictor::Data> candidates;
-    for (size_t i = 0; i < 2; ++i)
+    std::vector<size_t> offsets{0};
+    std::vector<uint32_t> indices;
+    std::vector<float> values;
+    for (size_t i = 0; i < 5; ++i)
     {
         candidates.emplace_back(240);
         auto& data = candidates.back();
-        for (size_t j = i; j < data.size(); j += 2)
+        for (size_t j = i; j < data.size(); j += 7 + i)
         {
             data[j] = 2 * i - 14.58f + 3 * j;
+            indices.push_back(j);
+            values.push_back(*data[j]);
         }
+        // feature out of model range and explicit NaN are missing
+        indices.push_back(1000);
+        values.push_back(1.0f);
+        indices.push_back(250);
+        values.push_back(std::numeric_limits<float>::quiet_NaN());
+        offsets.push_back(indices.size());
     }
 
-    auto scores = predictor.predict(candidates, false);
-    ASSERT_EQ(scores.size(), 2U);
-    ASSERT_FLOAT_EQ(scores[0], 0.15769163f);
-    ASSERT_FLOAT_EQ(scores[1], 0.18086274f);
+    const XGBoostPredictor::CSRData csr{offsets.data(), indices.data(), values.data(), candidates.size()};
+    ASSERT_EQ(predictor.predict(csr, false), predictor.predict(candidates, false));
+    ASSERT_EQ(predictor.predict(csr, true), predictor.predict(candidates, true));
 }
 
 //------------------------------------------------------------------------------ 
@@ -93,6 +1064,664 @@ TEST(XGBoostPredictor, Transform)
         ASSERT_FLOAT_EQ(v[1], 0.99999923f);
         ASSERT_FLOAT_EQ(v[2], 7.9097379e-07f);
     }
+    // matrix of partial rows, rows without columns
+    {
+        std::vector<float> v({1.0f, 2.0f, 3.0f});
+        ASSERT_THROW(XGBoostPredictor::transform(v, 2, XGBoostPredictor::Transformation::SOFTMAX), std::runtime_error);
+        ASSERT_THROW(XGBoostPredictor::transform(v.data(), v.size(), 2, XGBoostPredictor::Transformation::SOFTMAX), std::runtime_error);
+        XGBoostPredictor::transformSoftmax(nullptr, 4, 0);
+    }
+    // std::vector overloads compute expf like predict()
+    {
+        std::vector<float> v({-100.0f, -90.0f, 0.5f, 95.0f});
+        std::vector<float> sigmoid(v);
+        XGBoostPredictor::transformSigmoid(sigmoid);
+        for (size_t i = 0; i < v.size(); ++i)
+        {
+            ASSERT_EQ(sigmoid[i], 1.0f / (1.0f + expf(-v[i])));
+        }
+
+        std::vector<float> softmax({0.0f, -88.0f});
+        XGBoostPredictor::transformSoftmax(softmax);
+        ASSERT_EQ(softmax[0], 1.0f);
+        ASSERT_EQ(softmax[1], static_cast<float>(expf(-88.0f) / (1.0 + expf(-88.0f))));
+        ASSERT_GT(softmax[1], 0.0f);
+    }
+    // vectorized transformation of raw buffer
+    {
+        std::vector<float> v(1003);
+        for (size_t i = 0; i < v.size(); ++i)
+        {
+            v[i] = 0.173f * i - 90.0f;
+        }
+        std::vector<float> sigmoid(v);
+        XGBoostPredictor::transformSigmoid(sigmoid.data(), sigmoid.size());
+        for (size_t i = 0; i < v.size(); ++i)
+        {
+            ASSERT_FLOAT_EQ(sigmoid[i], 1.0f / (1.0f + expf(-v[i])));
+        }
+
+        std::vector<float> softmax(v.begin(), v.begin() + 30);
+        XGBoostPredictor::transform(softmax.data(), softmax.size(), XGBoostPredictor::Transformation::SOFTMAX);
+        float sum = 0.0f;
+        for (size_t i = 0; i < softmax.size(); ++i)
+        {
+            sum += expf(v[i] - v[29]);
+        }
+        for (size_t i = 0; i < softmax.size(); ++i)
+        {
+            ASSERT_FLOAT_EQ(softmax[i], expf(v[i] - v[29]) / sum);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+TEST(XGBoostPredictor, PredictMatrix)
+{
+    XGBoostPredictor::Options options;
+    options.tree_block_bytes = 1024;
+    XGBoostPredictor predictor("data/multiclass.model.json", options);   // "multi:softprob"
+    ASSERT_EQ(predictor.numPredictors(), 3U);
+
+    const size_t rows = 100;
+    const size_t columns = predictor.numFeatures();
+
+    std::vector<float> values(rows * columns);
+    std::vector<XGBoostPredictor::Data> data(rows, XGBoostPredictor::Data(columns));
+    for (size_t row = 0; row < rows; ++row)
+    {
+        for (size_t column = 0; column < columns; ++column)
+        {
+            const bool missing = (row + column) % 7 == 0;
+            values[row * columns + column] = missing ? std::numeric_limits<float>::quiet_NaN() : float((row * 31 + column * 17) % 41) / 2 - 10;
+            if (!missing)
+            {
+                data[row][column] = values[row * columns + column];
+            }
+        }
+    }
+
+    const XGBoostPredictor::DenseData dense{values.data(), rows, columns};
+
+    // margins are identical to row by row prediction
+    const auto margins = predictor.predictMatrix(dense, true);
+    ASSERT_EQ(margins.size(), rows * 3);
+    ASSERT_EQ(predictor.predictMatrix(data, true), margins);
+
+    const auto probabilities = predictor.predictMatrix(dense);
+    for (size_t row = 0; row < rows; ++row)
+    {
+        const auto margin = predictor.predict(data[row], true);
+        const auto probability = predictor.predict(data[row]);
+        for (size_t i = 0; i < 3; ++i)
+        {
+            ASSERT_EQ(margins[row * 3 + i], margin[i]);
+            ASSERT_EQ(probabilities[row * 3 + i], probability[i]);
+        }
+    }
+
+    // vectorized transformation of raw buffers
+    XGBoostPredictor::Options fast = options;
+    fast.fast_transform = true;
+    const XGBoostPredictor fastPredictor("data/multiclass.model.json", fast);
+    auto expected = margins;
+    XGBoostPredictor::transform(expected.data(), expected.size(), 3, XGBoostPredictor::Transformation::SOFTMAX);
+    const auto fastProbabilities = fastPredictor.predictMatrix(dense);
+    ASSERT_EQ(fastProbabilities, expected);
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+        ASSERT_NEAR(fastProbabilities[i], probabilities[i], 1e-6f);
+    }
+
+    // single predictor model
+    XGBoostPredictor binary("data/info.model.json");
+    ASSERT_EQ(binary.numPredictors(), 1U);
+    std::vector<float> binaryValues(2 * binary.numFeatures(), 1.5f);
+    const XGBoostPredictor::DenseData binaryDense{binaryValues.data(), 2, binary.numFeatures()};
+    ASSERT_EQ(binary.predictMatrix(binaryDense), binary.predict(binaryDense));
+}
+
+//------------------------------------------------------------------------------
+
+TEST(XGBoostPredictor, BinaryModel)
+{
+    const std::string file = testing::TempDir() + "info.model.bin";
+
+    XGBoostPredictor predictor("data/info.model.json");
+    predictor.save(file);
+
+    XGBoostPredictor binary(file);
+    ASSERT_EQ(binary.numFeatures(), predictor.numFeatures());
+    ASSERT_EQ(binary.model().nodes.size(), predictor.model().nodes.size());
+    ASSERT_EQ(std::memcmp(binary.model().nodes.data(), predictor.model().nodes.data(), predictor.model().nodes.size() * sizeof(XGBoostPredictor::Node)), 0);
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(binary.model().nodes.data()) % 64, 0U);
+
+    XGBoostPredictor::Data data(240);
+    for (size_t i = 0; i < data.size(); i += 2)
+    {
+        data[i] = 2 * i - 14.58f;
+    }
+    ASSERT_EQ(binary.predict(data), predictor.predict(data));
+
+    // multiclass model
+    XGBoostPredictor multiclass("data/multiclass.model.json");
+    multiclass.save(file);
+    ASSERT_EQ(XGBoostPredictor(file).predict(data), multiclass.predict(data));
+
+    // corrupted file
+    std::string bytes;
+    {
+        std::ifstream stream(file, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+    }
+    auto write = [&file](const std::string& bytes)
+    {
+        std::ofstream(file, std::ios::binary | std::ios::trunc).write(bytes.data(), bytes.size());
+    };
+
+    std::string corrupted = bytes;
+    corrupted[corrupted.size() / 2] ^= 1;
+    write(corrupted);
+    ASSERT_THROW(XGBoostPredictor{file}, std::runtime_error);
+
+    write(bytes.substr(0, bytes.size() - 64));
+    ASSERT_THROW(XGBoostPredictor{file}, std::runtime_error);
+
+    corrupted = bytes;
+    corrupted[8] = XGBoostPredictor::BINARY_VERSION + 1;   // version
+    write(corrupted);
+    ASSERT_THROW(XGBoostPredictor{file}, std::runtime_error);
+
+    // both children of root on the same decision node round-trip
+    const std::string jsonFile = testing::TempDir() + "shared.model.json";
+    std::ofstream(jsonFile) << R"({"learner": {"gradient_booster": {"model": {"trees": [{"default_left": [false, true, false, false],
+        "left_children": [1, 2, -1, -1], "right_children": [1, 3, -1, -1], "split_indices": [0, 1, 0, 0],
+        "split_conditions": [1, 2, 0.5, -0.5]}], "tree_info": [0]}}, "learner_model_param": {"base_score": "5E-1"},
+        "objective": {"name": "binary:logistic"}}})";
+    XGBoostPredictor shared(jsonFile);
+    std::remove(jsonFile.c_str());
+    shared.save(file);
+    XGBoostPredictor::Data row(2);
+    row[1] = 1.0f;
+    ASSERT_EQ(XGBoostPredictor(file).predict(row), shared.predict(row));
+
+    // checksum-valid file with a child before the first tree: tree 0 starts at node 1,
+    // node 1 refers to node 0, node 0 to itself
+    corrupted = bytes;
+    uint64_t nodesOffset = 0, treesOffset = 0;
+    std::memcpy(&nodesOffset, corrupted.data() + 32, sizeof(nodesOffset));
+    std::memcpy(&treesOffset, corrupted.data() + 48, sizeof(treesOffset));
+
+    XGBoostPredictor::Node nodes[2];
+    std::memcpy(nodes, corrupted.data() + nodesOffset, sizeof(nodes));
+    for (auto& node : nodes)
+    {
+        node.info &= ~(XGBoostPredictor::Node::YES_LEAF | XGBoostPredictor::Node::NO_LEAF);
+        node.children[0].offset = node.children[1].offset = 0;
+    }
+    const uint32_t root = 1;
+    std::memcpy(&corrupted[nodesOffset], nodes, sizeof(nodes));
+    std::memcpy(&corrupted[treesOffset], &root, sizeof(root));
+
+    // FNV-1a over 64-bit words with zero checksum field, as written by save()
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i + sizeof(uint64_t) <= corrupted.size(); i += sizeof(uint64_t))
+    {
+        uint64_t word = 0;
+        if (i != 24)
+        {
+            std::memcpy(&word, corrupted.data() + i, sizeof(word));
+        }
+        hash = (hash ^ word) * 0x100000001b3ULL;
+        hash ^= hash >> 32;
+    }
+    std::memcpy(&corrupted[24], &hash, sizeof(hash));
+    write(corrupted);
+    ASSERT_THROW(XGBoostPredictor{file}, std::runtime_error);
+
+    std::remove(file.c_str());
+}
+
+//------------------------------------------------------------------------------
+
+TEST(XGBoostPredictor, UbjsonModel)
+{
+    XGBoostPredictor json("data/multiclass.model.json");
+    XGBoostPredictor ubjson("data/multiclass.model.ubj");
+
+    ASSERT_EQ(ubjson.numFeatures(), json.numFeatures());
+    ASSERT_EQ(ubjson.model().nodes.size(), json.model().nodes.size());
+    ASSERT_EQ(std::memcmp(ubjson.model().nodes.data(), json.model().nodes.data(), json.model().nodes.size() * sizeof(XGBoostPredictor::Node)), 0);
+    ASSERT_EQ(ubjson.model().transformation, json.model().transformation);
+
+    XGBoostPredictor::Data data(json.numFeatures());
+    for (size_t i = 0; i < data.size(); i += 3)
+    {
+        data[i] = i - 5.5f;
+    }
+    ASSERT_EQ(ubjson.predict(data), json.predict(data));
+
+    // truncated file
+    const std::string file = testing::TempDir() + "model.ubj";
+    {
+        std::ifstream stream("data/multiclass.model.ubj", std::ios::binary);
+        const std::string bytes((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+        std::ofstream(file, std::ios::binary).write(bytes.data(), bytes.size() / 2);
+    }
+    ASSERT_THROW(XGBoostPredictor{file}, std::runtime_error);
+    std::remove(file.c_str());
+}
+
+//------------------------------------------------------------------------------
+
+TEST(XGBoostPredictor, ParseModel)
+{
+    const std::string file = testing::TempDir() + "model.json";
+
+    auto parse = [&file](const std::string& trees, const std::string& treeInfo)
+    {
+        std::ofstream(file) << R"({"version": [1, 7, 0], "learner": {"attributes": {},
+            "gradient_booster": {"name": "gbtree", "model": {"gbtree_model_param": {"num_trees": "2"},
+            "trees": [)" << trees << R"(], "tree_info": )" << treeInfo << R"(}},
+            "learner_model_param": {"base_score": "5E-1", "num_class": "0"},
+            "objective": {"name": "binary:logistic", "reg_loss_param": {"scale_pos_weight": "1"}}}})";
+        return XGBoostPredictor(file);
+    };
+
+    // unused members are skipped
+    const std::string tree = R"({"base_weights": [0.1, 0.2, 0.3], "loss_changes": [1.5, 0, 0], "sum_hessian": [3, 1, 2],
+        "tree_param": {"num_nodes": "3"}, "categories": [], "id": 0,
+        "default_left": [true, false, false], "left_children": [1, -1, -1], "right_children": [2, -1, -1],
+        "split_indices": [3, 0, 0], "split_conditions": [0.5, -1, 2.5]})";
+    const auto predictor = parse(tree + ", " + tree, "[0, 0]");
+    ASSERT_EQ(predictor.numFeatures(), 4U);
+
+    XGBoostPredictor::Data data(4);
+    ASSERT_FLOAT_EQ(predictor.predict(data, true)[0], -2.0f);
+    data[3] = 1.0f;
+    ASSERT_FLOAT_EQ(predictor.predict(data, true)[0], 5.0f);
+
+    // invalid models
+    ASSERT_THROW(parse(tree, "[0, 0]"), std::runtime_error);
+    ASSERT_THROW(parse(tree, "[0, \"0\"]"), std::runtime_error);
+    ASSERT_THROW(parse(R"({"left_children": [-1], "right_children": [-1], "split_indices": [0], "split_conditions": [1]})", "[0]"), std::runtime_error);
+    ASSERT_THROW(parse(R"({"default_left": [2], "left_children": [-1], "right_children": [-1], "split_indices": [0], "split_conditions": [1]})", "[0]"), std::runtime_error);
+    ASSERT_THROW(parse(R"({"default_left": [false, false], "left_children": [-1], "right_children": [-1], "split_indices": [0], "split_conditions": [1]})", "[0]"), std::runtime_error);
+    ASSERT_THROW(parse(R"({"default_left": [false], "left_children": [0], "right_children": [0], "split_indices": [0], "split_conditions": [1]})", "[0]"), std::runtime_error);
+
+    std::ofstream(file) << R"({"learner": {"gradient_booster": {"model": {"trees": []}}}})";
+    ASSERT_THROW(XGBoostPredictor{file}, std::runtime_error);
+
+    std::ofstream(file) << R"({"learner": )";
+    ASSERT_THROW(XGBoostPredictor{file}, std::runtime_error);
+
+    std::remove(file.c_str());
+}
+
+//------------------------------------------------------------------------------
+
+TEST(XGBoostPredictor, ParallelLoad)
+{
+    XGBoostPredictor::Options options;
+    options.executor = std::make_shared<ThreadPool>(4);
+
+    // trees checked and packed in parallel give the same model
+    for (const char* file : {"data/info.model.json", "data/multiclass.model.json", "data/multiclass.model.ubj"})
+    {
+        const XGBoostPredictor sequential(file);
+        const XGBoostPredictor parallel(file, options);
+
+        const auto& expected = sequential.model();
+        const auto& model = parallel.model();
+        ASSERT_EQ(model.nodes.size(), expected.nodes.size());
+        ASSERT_EQ(std::memcmp(model.nodes.data(), expected.nodes.data(), expected.nodes.size() * sizeof(XGBoostPredictor::Node)), 0);
+        ASSERT_EQ(model.trees.size(), expected.trees.size());
+        ASSERT_EQ(std::memcmp(model.trees.data(), expected.trees.data(), expected.trees.size() * sizeof(XGBoostPredictor::Tree)), 0);
+        ASSERT_EQ(model.num_features, expected.num_features);
+    }
+
+    // deep degenerate tree is checked without recursion, deep subtree on yes or no side
+    // (QuickScorer leaf ranges of yes subtrees are quadratic in depth on the yes side)
+    const size_t depth = 300000;
+    const std::string file = testing::TempDir() + "deep.model.json";
+    auto write = [&file, depth](const bool yesDeep)
+    {
+        std::string defaultLeft, left, right, indices, conditions;
+        for (size_t i = 0; i < 2 * depth + 1; ++i)
+        {
+            const bool leaf = i % 2 == 1 || i == 2 * depth;
+            const char* separator = i ? ", " : "";
+            defaultLeft += separator + std::string("false");
+            left += separator + std::to_string(leaf ? -1 : static_cast<long>(yesDeep ? i + 2 : i + 1));
+            right += separator + std::to_string(leaf ? -1 : static_cast<long>(yesDeep ? i + 1 : i + 2));
+            indices += separator + std::string(leaf ? "0" : "1");
+            conditions += separator + std::string(leaf ? "0.5" : "1.0");
+        }
+
+        std::ofstream(file) << R"({"learner": {"gradient_booster": {"model": {"trees": [{"default_left": [)" << defaultLeft <<
+                R"(], "left_children": [)" << left << R"(], "right_children": [)" << right << R"(], "split_indices": [)" << indices <<
+                R"(], "split_conditions": [)" << conditions << R"(]}], "tree_info": [0]}},
+                "learner_model_param": {"base_score": "0"}, "objective": {"name": "reg:squarederror"}}})";
+    };
+
+    write(true);
+    const XGBoostPredictor deep(file, options);
+    ASSERT_EQ(deep.model().nodes.size(), depth);
+    ASSERT_FLOAT_EQ(deep.predict(XGBoostPredictor::Data{0.0f, 0.0f}, true)[0], 0.5f);
+
+    write(false);
+    XGBoostPredictor::Options quickScorer = options;
+    quickScorer.engine = XGBoostPredictor::Engine::QUICKSCORER;
+    const XGBoostPredictor deepQuickScorer(file, quickScorer);
+    ASSERT_EQ(deepQuickScorer.model().nodes.size(), depth);
+    ASSERT_FLOAT_EQ(deepQuickScorer.predict(XGBoostPredictor::Data{0.0f, 2.0f}, true)[0], 0.5f);
+    ASSERT_FLOAT_EQ(deepQuickScorer.predict(XGBoostPredictor::Data{0.0f, 0.0f}, true)[0], 0.5f);
+    std::remove(file.c_str());
+}
+
+//------------------------------------------------------------------------------
+
+TEST(XGBoostPredictor, Holder)
+{
+    const std::string file = testing::TempDir() + "holder.model.bin";
+    const std::string next = testing::TempDir() + "holder.next.bin";
+
+    const XGBoostPredictor binary("data/info.model.json");
+    const XGBoostPredictor multiclass("data/multiclass.model.json");
+    binary.save(file);
+    multiclass.save(next);
+
+    XGBoostPredictor::Data data(240);
+    for (size_t i = 0; i < data.size(); i += 2)
+    {
+        data[i] = 2 * i - 14.58f;
+    }
+
+    XGBoostPredictorHolder holder(file);
+    ASSERT_EQ(holder.predict(data), binary.predict(data));
+    ASSERT_EQ(holder.stats().swaps, 1U);
+    ASSERT_EQ(holder.stats().live, 1U);
+
+    // in-flight predictor survives swap
+    const auto previous = holder.acquire();
+    holder.reloadAsync(next).get();
+    ASSERT_EQ(holder.predict(data), multiclass.predict(data));
+    ASSERT_EQ(previous->predict(data), binary.predict(data));
+    ASSERT_EQ(holder.stats().live, 2U);
+
+    // failed load keeps current predictor
+    ASSERT_THROW(holder.reloadAsync("foo.bar").get(), std::runtime_error);
+    ASSERT_EQ(holder.stats().failed_loads, 1U);
+    ASSERT_EQ(holder.predict(data), multiclass.predict(data));
+
+    // concurrent readers see either model
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> readers;
+    for (size_t i = 0; i < 4; ++i)
+    {
+        readers.emplace_back([&]()
+        {
+            while (!stop)
+            {
+                const size_t size = holder.predict(data).size();
+                ASSERT_TRUE(size == 1 || size == 3);
+            }
+        });
+    }
+
+    for (size_t i = 0; i < 20; ++i)
+    {
+        holder.reload(i % 2 ? next : file);
+    }
+
+    stop = true;
+    for (auto& reader : readers)
+    {
+        reader.join();
+    }
+
+    // idle threads do not keep a retired predictor
+    std::weak_ptr<const XGBoostPredictor> retired = holder.acquire();
+    std::promise<void> predicted, swapped;
+    std::thread idle([&]()
+    {
+        holder.predict(data);
+        predicted.set_value();
+        swapped.get_future().wait();
+    });
+    predicted.get_future().wait();
+    holder.reload(file);
+    ASSERT_TRUE(retired.expired());
+    swapped.set_value();
+    idle.join();
+
+    // predictor() reference keeps retired predictor until the next call of its thread
+    retired = holder.acquire();
+    std::promise<void> referenced, reloaded;
+    std::thread pinned([&]()
+    {
+        const auto& predictor = holder.predictor();
+        referenced.set_value();
+        reloaded.get_future().wait();
+        ASSERT_EQ(predictor.predict(data), binary.predict(data));
+        ASSERT_FALSE(retired.expired());
+        ASSERT_EQ(holder.predictor().predict(data), multiclass.predict(data));
+        ASSERT_TRUE(retired.expired());
+    });
+    referenced.get_future().wait();
+    const uint64_t maxOverlap = holder.stats().max_overlap_ns;
+    holder.reload(next);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    reloaded.set_value();
+    pinned.join();
+    ASSERT_GE(holder.stats().overlap_ns, 10000000U);
+    ASSERT_GE(holder.stats().max_overlap_ns, std::max<uint64_t>(maxOverlap, 10000000U));
+
+    // file watch
+    holder.watch(std::chrono::milliseconds(5));
+    const uint64_t swaps = holder.stats().swaps;
+    std::rename(file.c_str(), next.c_str());
+
+    for (size_t i = 0; i < 400 && holder.stats().swaps == swaps; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    holder.watch(std::chrono::milliseconds(0));
+    ASSERT_EQ(holder.stats().swaps, swaps + 1);
+    ASSERT_EQ(holder.predict(data), binary.predict(data));
+
+    const auto stats = holder.stats();
+    ASSERT_GT(stats.load_ns, 0U);
+    ASSERT_GT(stats.max_overlap_ns, 0U);
+
+    // destroyed holder releases its predictor on all threads
+    std::weak_ptr<const XGBoostPredictor> released;
+    {
+        XGBoostPredictorHolder temporary(next);
+        temporary.predict(data);
+        released = temporary.acquire();
+    }
+    ASSERT_TRUE(released.expired());
+
+    auto temporary = std::make_unique<XGBoostPredictorHolder>(next);
+    released = temporary->acquire();
+    std::promise<void> used, destroyed;
+    std::thread pooled([&]()
+    {
+        temporary->predict(data);
+        used.set_value();
+        destroyed.get_future().wait();
+        ASSERT_TRUE(released.expired());
+        holder.predict(data);
+    });
+    used.get_future().wait();
+    temporary.reset();
+    destroyed.set_value();
+    pooled.join();
+
+    std::remove(next.c_str());
+}
+
+//------------------------------------------------------------------------------
+
+TEST(XGBoostPredictor, Batcher)
+{
+    const auto binary = std::make_shared<const XGBoostPredictor>("data/info.model.json");
+    const auto multiclass = std::make_shared<const XGBoostPredictor>("data/multiclass.model.json");
+
+    const auto candidates = TestRows(64, 240).data;
+
+    // full batch is dispatched without waiting
+    XGBoostPredictorBatcher::Options options;
+    options.max_batch = 8;
+    options.max_wait = std::chrono::seconds(10);
+    {
+        auto batcher = std::make_unique<XGBoostPredictorBatcher>(binary, options);
+        std::vector<std::future<std::vector<float>>> futures;
+        for (size_t i = 0; i < 8; ++i)
+        {
+            futures.push_back(batcher->submit(candidates[i], i % 2));
+        }
+        for (size_t i = 0; i < 8; ++i)
+        {
+            ASSERT_EQ(futures[i].get(), binary->predict(candidates[i], i % 2));
+        }
+
+        const auto stats = batcher->stats();
+        ASSERT_EQ(stats.requests, 8U);
+        ASSERT_EQ(stats.batches, 1U);
+        ASSERT_EQ(stats.full_batches, 1U);
+        ASSERT_EQ(stats.max_batch, 8U);
+        ASSERT_EQ(stats.queue_depth, 0U);
+
+        // waiting rows are completed on destruction
+        auto future = batcher->submit(candidates[0]);
+        ASSERT_EQ(future.wait_for(std::chrono::milliseconds(1)), std::future_status::timeout);
+        batcher.reset();
+        ASSERT_EQ(future.get(), binary->predict(candidates[0]));
+    }
+
+    // partial batch is dispatched after max_wait
+    options.max_wait = std::chrono::milliseconds(1);
+    {
+        XGBoostPredictorBatcher batcher(binary, options);
+        auto future = batcher.submit(candidates[1]);
+        ASSERT_EQ(future.get(), binary->predict(candidates[1]));
+        ASSERT_EQ(batcher.stats().full_batches, 0U);
+    }
+
+    // concurrent clients with callbacks
+    options.threads = 2;
+    XGBoostPredictorBatcher batcher(multiclass, options);
+    std::atomic<size_t> completed{0};
+    std::atomic<size_t> mismatches{0};
+    std::vector<std::thread> clients;
+    for (size_t client = 0; client < 4; ++client)
+    {
+        clients.emplace_back([&, client]()
+        {
+            for (size_t i = client; i < 400; i += 4)
+            {
+                const auto& data = candidates[i % candidates.size()];
+                batcher.submit(data, [&, expected = multiclass->predict(data)](std::vector<float> predictions, std::exception_ptr)
+                {
+                    mismatches += predictions != expected;
+                    ++completed;
+                });
+            }
+        });
+    }
+    for (auto& client : clients)
+    {
+        client.join();
+    }
+
+    for (size_t i = 0; i < 1000 && completed < 400; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_EQ(completed, 400U);
+    ASSERT_EQ(mismatches, 0U);
+
+    const auto stats = batcher.stats();
+    ASSERT_EQ(stats.rows, 400U);
+    ASSERT_LE(stats.max_batch, 8U);
+    ASSERT_GE(stats.max_queue_depth, 1U);
+    ASSERT_GT(stats.predict_ns, 0U);
+}
+
+//------------------------------------------------------------------------------
+
+TEST(XGBoostPredictor, PredictNoAllocation)
+{
+    const XGBoostPredictor predictor("data/info.model.json");
+    XGBoostPredictor::Options options;
+    options.engine = XGBoostPredictor::Engine::QUICKSCORER;
+    const XGBoostPredictor quickScorer("data/info.model.json", options);
+    const XGBoostPredictor multiclass("data/multiclass.model.json");
+
+    const TestRows rows(100, predictor.numFeatures());
+    const auto& candidates = rows.data;
+    const auto& values = rows.values;
+    const auto dense = rows.dense();
+
+    std::vector<size_t> offsets{0};
+    std::vector<uint32_t> indices;
+    std::vector<float> csrValues;
+    for (const auto& data : candidates)
+    {
+        for (size_t j = 0; j < data.size(); ++j)
+        {
+            if (data[j])
+            {
+                indices.push_back(j);
+                csrValues.push_back(*data[j]);
+            }
+        }
+        offsets.push_back(indices.size());
+    }
+    const XGBoostPredictor::CSRData csr{offsets.data(), indices.data(), csrValues.data(), candidates.size()};
+
+    std::vector<float> scores(candidates.size() * multiclass.numPredictors());
+
+    auto predictAll = [&]()
+    {
+        for (const bool outputMargin : {false, true})
+        {
+            predictor.predict(candidates[0], scores.data(), 1, outputMargin);
+            predictor.predict(values.data(), predictor.numFeatures(), scores.data(), 1, outputMargin);
+            quickScorer.predict(values.data(), predictor.numFeatures(), scores.data(), 1, outputMargin);
+            predictor.predict(candidates, scores.data(), candidates.size(), outputMargin);
+            predictor.predict(dense, scores.data(), candidates.size(), outputMargin);
+            predictor.predict(csr, scores.data(), candidates.size(), outputMargin);
+            multiclass.predict(candidates[0], scores.data(), multiclass.numPredictors(), outputMargin);
+            multiclass.predictMatrix(candidates, scores.data(), scores.size(), outputMargin);
+            multiclass.predictMatrix(dense, scores.data(), scores.size(), outputMargin);
+        }
+    };
+
+    // first calls size per-thread scratch buffers
+    predictAll();
+
+    const size_t before = allocations;
+    predictAll();
+    ASSERT_EQ(allocations - before, 0U);
+    predictor.predict(candidates[0]);
+    ASSERT_GT(allocations - before, 0U);
+
+    // same results as returned vectors
+    predictor.predict(candidates[1], scores.data(), 1);
+    ASSERT_EQ(scores[0], predictor.predict(candidates[1])[0]);
+    quickScorer.predict(values.data(), predictor.numFeatures(), scores.data(), 1, true);
+    ASSERT_EQ(scores[0], predictor.predict(candidates[0], true)[0]);
+    predictor.predict(csr, scores.data(), scores.size());
+    ASSERT_EQ(std::vector<float>(scores.begin(), scores.begin() + candidates.size()), predictor.predict(candidates));
+    multiclass.predictMatrix(dense, scores.data(), scores.size());
+    ASSERT_EQ(scores, multiclass.predictMatrix(candidates));
+
+    ASSERT_THROW(multiclass.predict(candidates[0], scores.data(), 2), std::runtime_error);
+    ASSERT_THROW(multiclass.predictMatrix(dense, scores.data(), scores.size() - 1), std::runtime_error);
 }
 
 //------------------------------------------------------------------------------
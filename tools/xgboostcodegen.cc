@@ -0,0 +1,30 @@
+#include "xgboostcodegenerator.h"
+
+#include <iostream>
+
+using namespace xgboost::predictor;
+
+//------------------------------------------------------------------------------
+// compile XGBoost JSON model to C++ header
+//------------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << "usage: " << argv[0] << " <model.json> <class name> [namespace] > header.h" << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        const XGBoostPredictor predictor(argv[1]);
+        XGBoostCodeGenerator::generate(predictor, argv[2], argc > 3 ? argv[3] : "", std::cout);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
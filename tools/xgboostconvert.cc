@@ -0,0 +1,30 @@
+#include "xgboostpredictor.h"
+
+#include <iostream>
+
+using namespace xgboost::predictor;
+
+//------------------------------------------------------------------------------
+// convert XGBoost JSON model to binary model file
+//------------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << "usage: " << argv[0] << " <model.json> <model.bin>" << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        const XGBoostPredictor predictor(argv[1]);
+        predictor.save(argv[2]);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}